@@ -0,0 +1,47 @@
+#version 100
+#extension GL_OES_standard_derivatives : enable
+
+// GLSL 100 version of glsl330/grid.frag, for the web and Android builds. fwidth() comes from
+// OES_standard_derivatives, which WebGL and nearly every GLES2 driver expose. World positions on
+// a large map need highp where there is one.
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+
+uniform float tileSize;    // World units
+uniform float majorEvery;  // Tiles
+uniform vec2 offset;       // Camera2D
+uniform vec2 target;
+uniform float zoom;
+uniform float rotation;    // Radians
+uniform vec2 resolution;   // Screen pixels
+
+// 1 on a line, 0 away from it, anti-aliased over about a pixel.
+float lines(vec2 world, float cell) {
+    vec2 coord = world / cell;
+    vec2 width = fwidth(coord);
+    vec2 distance = abs(fract(coord - 0.5) - 0.5) / width;
+    return 1.0 - min(min(distance.x, distance.y), 1.0);
+}
+
+void main() {
+    vec2 screen = vec2(gl_FragCoord.x, resolution.y - gl_FragCoord.y);
+    vec2 local = (screen - offset) / zoom;
+    float c = cos(-rotation), s = sin(-rotation);
+    vec2 world = vec2(c * local.x - s * local.y, s * local.x + c * local.y) + target;
+
+    float minorPixels = tileSize * zoom;
+    float minorFade = smoothstep(4.0, 12.0, minorPixels);
+    float majorFade = smoothstep(4.0, 12.0, minorPixels * majorEvery);
+
+    float minor = lines(world, tileSize) * minorFade * 0.5;
+    float major = lines(world, tileSize * majorEvery) * majorFade;
+
+    gl_FragColor = vec4(fragColor.rgb, fragColor.a * max(minor, major));
+}
@@ -0,0 +1,38 @@
+#version 100
+
+// GLSL 100 version of glsl330/textmode.frag, for the web and Android builds. There's no
+// texelFetch(), so the data textures are sampled at cell centres, which is exact with the point
+// filtering they're loaded with. The glyph index needs more than mediump's 11 bits when it can.
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+
+uniform sampler2D texture0;   // Glyph indices
+uniform sampler2D fgColors;
+uniform sampler2D bgColors;
+uniform sampler2D charSheet;  // Light glyphs on a dark or transparent background
+uniform vec2 gridSize;        // In cells
+uniform vec2 sheetSize;       // In glyphs
+
+void main() {
+    vec2 position = fragTexCoord * gridSize;
+    vec2 cell = (min(floor(position), gridSize - 1.0) + 0.5) / gridSize;
+    vec2 local = fract(position);
+
+    vec4 index = texture2D(texture0, cell);
+    float glyph = floor(index.r * 255.0 + 0.5) + floor(index.g * 255.0 + 0.5) * 256.0;
+    vec2 origin = vec2(mod(glyph, sheetSize.x), floor(glyph / sheetSize.x));
+
+    vec4 texel = texture2D(charSheet, (origin + local) / sheetSize);
+    float mask = texel.a * max(texel.r, max(texel.g, texel.b));
+
+    vec4 fg = texture2D(fgColors, cell);
+    vec4 bg = texture2D(bgColors, cell);
+    gl_FragColor = mix(bg, fg, mask) * fragColor;
+}
@@ -0,0 +1,43 @@
+#version 330 core
+
+// Tile grid, drawn over the map's rectangle in one pass. Each fragment is taken back to world space
+// through the camera. Minor lines fall on tile borders and major lines every majorEvery tiles.
+// Lines are anti-aliased against their screen-space footprint, and each level fades out as its
+// cells get too small on screen, so the cost doesn't change with zoom or map size.
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform float tileSize;    // World units
+uniform float majorEvery;  // Tiles
+uniform vec2 offset;       // Camera2D
+uniform vec2 target;
+uniform float zoom;
+uniform float rotation;    // Radians
+uniform vec2 resolution;   // Screen pixels
+
+out vec4 finalColor;
+
+// 1 on a line, 0 away from it, anti-aliased over about a pixel.
+float lines(vec2 world, float cell) {
+    vec2 coord = world / cell;
+    vec2 width = fwidth(coord);
+    vec2 distance = abs(fract(coord - 0.5) - 0.5) / width;
+    return 1.0 - min(min(distance.x, distance.y), 1.0);
+}
+
+void main() {
+    vec2 screen = vec2(gl_FragCoord.x, resolution.y - gl_FragCoord.y);
+    vec2 local = (screen - offset) / zoom;
+    float c = cos(-rotation), s = sin(-rotation);
+    vec2 world = vec2(c * local.x - s * local.y, s * local.x + c * local.y) + target;
+
+    float minorPixels = tileSize * zoom;
+    float minorFade = smoothstep(4.0, 12.0, minorPixels);
+    float majorFade = smoothstep(4.0, 12.0, minorPixels * majorEvery);
+
+    float minor = lines(world, tileSize) * minorFade * 0.5;
+    float major = lines(world, tileSize * majorEvery) * majorFade;
+
+    finalColor = vec4(fragColor.rgb, fragColor.a * max(minor, major));
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+// Text-mode console, drawn as one quad over the whole grid. Every cell is one texel of the data
+// textures: texture0 holds its glyph index (low byte in red, high byte in green), fgColors and
+// bgColors its colours. The glyph is looked up in the charsheet and used as a mask between them.
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;   // Glyph indices
+uniform sampler2D fgColors;
+uniform sampler2D bgColors;
+uniform sampler2D charSheet;  // Light glyphs on a dark or transparent background
+uniform vec2 gridSize;        // In cells
+uniform vec2 sheetSize;       // In glyphs
+
+out vec4 finalColor;
+
+void main() {
+    vec2 position = fragTexCoord * gridSize;
+    ivec2 cell = ivec2(min(floor(position), gridSize - 1.0));
+    vec2 local = fract(position);
+
+    vec4 index = texelFetch(texture0, cell, 0);
+    float glyph = floor(index.r * 255.0 + 0.5) + floor(index.g * 255.0 + 0.5) * 256.0;
+    vec2 origin = vec2(mod(glyph, sheetSize.x), floor(glyph / sheetSize.x));
+
+    vec4 texel = textureLod(charSheet, (origin + local) / sheetSize, 0.0);
+    float mask = texel.a * max(texel.r, max(texel.g, texel.b));
+
+    vec4 fg = texelFetch(fgColors, cell, 0);
+    vec4 bg = texelFetch(bgColors, cell, 0);
+    finalColor = mix(bg, fg, mask) * fragColor;
+}
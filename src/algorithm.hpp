@@ -1,17 +1,39 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cfloat>
+#include <charconv>
 #include <chrono>
 #include <cmath>
 #include <concepts>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <source_location>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define FILEWATCHER_INOTIFY
+#endif
 
 namespace fs = std::filesystem;
 namespace ch = std::chrono;
@@ -47,20 +69,137 @@ typedef Vector2i p2i;
 typedef Vector2u v2u;
 typedef Vector2u p2u;
 
-v2 operator-(v2 const& lhs, v2 const& rhs) {
-    return v2{lhs.x - rhs.x, lhs.y - rhs.y};
+// Signed fixed-point number with F fractional bits, for exact arithmetic on grid coordinates.
+// Products and quotients round down.
+template <u32 F>
+struct Fixed {
+    static constexpr i32 One = 1 << F;
+
+    i32 raw = 0;
+
+    constexpr Fixed() = default;
+    template <std::integral T>
+    explicit constexpr Fixed(T integer) : raw((i32)(integer * One)) {}
+    template <std::floating_point T>
+    explicit constexpr Fixed(T real) : raw((i32)(real * One + (real < 0 ? -0.5 : 0.5))) {}
+
+    static constexpr Fixed FromRaw(i32 raw) {
+        Fixed result;
+        result.raw = raw;
+        return result;
+    }
+
+    explicit constexpr operator f64() const { return (f64)raw / One; }
+
+    constexpr Fixed operator-() const { return FromRaw(-raw); }
+    constexpr Fixed operator+(Fixed rhs) const { return FromRaw(raw + rhs.raw); }
+    constexpr Fixed operator-(Fixed rhs) const { return FromRaw(raw - rhs.raw); }
+    constexpr Fixed operator*(Fixed rhs) const { return FromRaw((i32)(((i64)raw * rhs.raw) >> F)); }
+    constexpr Fixed operator/(Fixed rhs) const {
+        return FromRaw((i32)(((i64)raw * One) / rhs.raw));
+    }
+
+    constexpr Fixed& operator+=(Fixed rhs) { return *this = *this + rhs; }
+    constexpr Fixed& operator-=(Fixed rhs) { return *this = *this - rhs; }
+
+    constexpr auto operator<=>(const Fixed&) const = default;
+};
+
+typedef Fixed<16> fx;
+
+struct Vector2d {
+    f64 x, y;
+};
+
+struct Vector2fx {
+    fx x, y;
+};
+
+typedef Vector2d v2d;
+typedef Vector2d p2d;
+
+typedef Vector2fx v2fx;
+typedef Vector2fx p2fx;
+
+// What the geometry kernels need from a coordinate type, resolved at compile time. Widen() maps a
+// coordinate onto Wide, where sums, differences and products of two differences are exact for the
+// integer types while coordinates (raw values for Fixed) stay within +-2^29; Narrow() maps a Wide
+// sum back. Real is what lengths, angles and disks come out in.
+template <typename T>
+struct ScalarTraits;
+
+template <typename T>
+    requires std::floating_point<T>
+struct ScalarTraits<T> {
+    using Wide = T;
+    using Real = T;
+
+    static constexpr bool exact = false;
+
+    static constexpr Wide Widen(T value) { return value; }
+    static constexpr T    Narrow(Wide value) { return value; }
+    static constexpr Real ToReal(T value) { return value; }
+};
+
+template <>
+struct ScalarTraits<i32> {
+    using Wide = i64;
+    using Real = f64;
+
+    static constexpr bool exact = true;
+
+    static constexpr Wide Widen(i32 value) { return value; }
+    static constexpr i32  Narrow(Wide value) { return (i32)value; }
+    static constexpr Real ToReal(i32 value) { return value; }
+};
+
+template <u32 F>
+struct ScalarTraits<Fixed<F>> {
+    using Wide = i64;  // Raw values, so products carry 2F fractional bits
+    using Real = f64;
+
+    static constexpr bool exact = true;
+
+    static constexpr Wide     Widen(Fixed<F> value) { return value.raw; }
+    static constexpr Fixed<F> Narrow(Wide value) { return Fixed<F>::FromRaw((i32)value); }
+    static constexpr Real     ToReal(Fixed<F> value) { return (f64)value; }
+};
+
+// Any struct of just an x and a y of a type with ScalarTraits: v2, v2d, v2i, v2fx.
+template <typename P>
+concept Point2D = requires(P p) {
+    ScalarTraits<decltype(P::x)>::exact;
+    requires std::same_as<decltype(P::x), decltype(P::y)>;
+    requires sizeof(P) == 2 * sizeof(P::x);
+};
+
+template <Point2D P>
+using ScalarOf = decltype(P::x);
+
+template <Point2D P>
+using TraitsOf = ScalarTraits<ScalarOf<P>>;
+
+template <Point2D P>
+using RealOf = typename TraitsOf<P>::Real;
+
+template <Point2D P>
+P operator-(P const& lhs, P const& rhs) {
+    return P{lhs.x - rhs.x, lhs.y - rhs.y};
 }
 
-v2 operator+(v2 const& lhs, v2 const& rhs) {
-    return v2{lhs.x + rhs.x, lhs.y + rhs.y};
+template <Point2D P>
+P operator+(P const& lhs, P const& rhs) {
+    return P{lhs.x + rhs.x, lhs.y + rhs.y};
 }
 
-v2 operator*(f32 const& lhs, v2 const& rhs) {
-    return v2{lhs * rhs.x, lhs * rhs.y};
+template <Point2D P>
+P operator*(ScalarOf<P> const& lhs, P const& rhs) {
+    return P{lhs * rhs.x, lhs * rhs.y};
 }
 
-v2 operator/(v2 const& lhs, f32 const& rhs) {
-    return v2{lhs.x / rhs, lhs.y / rhs};
+template <Point2D P>
+P operator/(P const& lhs, ScalarOf<P> const& rhs) {
+    return P{lhs.x / rhs, lhs.y / rhs};
 }
 
 v3 operator-(v3 const& lhs, v3 const& rhs) {
@@ -86,42 +225,288 @@ class ArenaOverflow : public std::exception {
     const char* what() { return "Arena allocation overflowed"; }
 };
 
+class Arena;
+
+#define MEMORY_HISTORY 256  // Frames of allocation counts kept
+#define MEMORY_CSV_PATH "../benchmarks/memory.csv"
+
+// Allocations made in one frame, heap and arena.
+struct FrameMemory {
+    u64 heapAllocations = 0, heapBytes = 0;
+    u64 arenaAllocations = 0, arenaBytes = 0;
+};
+
+// Arena allocations made from one line of code.
+struct AllocationSite {
+    const char* file;
+    const char* function;
+    u32         line;
+    u64         allocations = 0, bytes = 0;
+};
+
+// Where memory goes. Every arena is listed here with its own counters, and arena allocations are
+// counted per frame. With MEMORY_TELEMETRY defined, heap allocations through the global operator
+// new and delete are counted too, and arena allocations per callsite. The main loop calls
+// FrameMark() once per frame, so a benchmark can check that a frame allocated nothing.
+class MemoryTelemetry {
+    static inline std::atomic<u64> frameHeapAllocations{0}, frameHeapBytes{0};
+    static inline std::atomic<u64> frameArenaAllocations{0}, frameArenaBytes{0};
+
+    static inline FrameMemory history[MEMORY_HISTORY];
+    static inline u64         frameCount = 0;
+
+    // Leaked on purpose: static arenas unregister after static destructors have run.
+    static std::mutex& lock() {
+        static auto* mutex = new std::mutex;
+        return *mutex;
+    }
+
+    static std::vector<Arena*>& arenas() {
+        static auto* list = new std::vector<Arena*>;
+        return *list;
+    }
+
+    // Keyed by file and line, so looking up a site that's been seen allocates nothing.
+    using SiteKey = std::pair<const char*, u32>;
+    struct SiteHash {
+        usize operator()(const SiteKey& key) const {
+            return std::hash<const char*>{}(key.first) * 31 + key.second;
+        }
+    };
+
+    static std::unordered_map<SiteKey, AllocationSite, SiteHash>& sites() {
+        static auto* map = new std::unordered_map<SiteKey, AllocationSite, SiteHash>;
+        return *map;
+    }
+
+   public:
+    // Heap bytes allocated and not freed yet, and the most there's been. MEMORY_TELEMETRY only.
+    static inline std::atomic<u64> heapAllocations{0}, heapLive{0}, heapPeak{0};
+
+    // Arenas Arrays make for themselves, never freed, so only counted rather than listed.
+    static inline std::atomic<u64> arrayArenas{0}, arrayBytes{0};
+
+    static void RecordHeap(usize bytes) {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        frameHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+        frameHeapBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        const u64 live = heapLive.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        u64       peak = heapPeak.load(std::memory_order_relaxed);
+        while (live > peak && !heapPeak.compare_exchange_weak(peak, live)) {}
+    }
+
+    static void RecordFree(usize bytes) { heapLive.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    static void RecordArena(usize bytes, [[maybe_unused]] const std::source_location& where) {
+        frameArenaAllocations.fetch_add(1, std::memory_order_relaxed);
+        frameArenaBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+#if defined(MEMORY_TELEMETRY)
+        std::lock_guard guard{lock()};
+        const SiteKey   key{where.file_name(), where.line()};
+        auto [it, inserted] = sites().try_emplace(
+            key, AllocationSite{where.file_name(), where.function_name(), where.line()});
+        it->second.allocations++;
+        it->second.bytes += bytes;
+#endif
+    }
+
+    static void RecordArray(usize bytes) {
+        arrayArenas.fetch_add(1, std::memory_order_relaxed);
+        arrayBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    static void Register(Arena* arena) {
+        std::lock_guard guard{lock()};
+        arenas().push_back(arena);
+    }
+
+    static void Unregister(Arena* arena) {
+        std::lock_guard guard{lock()};
+        std::erase(arenas(), arena);
+    }
+
+    // Closes the frame's counts. Main thread only.
+    static void FrameMark() {
+        history[frameCount++ % MEMORY_HISTORY] = FrameMemory{
+            frameHeapAllocations.exchange(0, std::memory_order_relaxed),
+            frameHeapBytes.exchange(0, std::memory_order_relaxed),
+            frameArenaAllocations.exchange(0, std::memory_order_relaxed),
+            frameArenaBytes.exchange(0, std::memory_order_relaxed),
+        };
+    }
+
+    // The last frame closed, or frames ago frames before that.
+    static FrameMemory Frame(u64 ago = 0) {
+        if (ago >= std::min<u64>(frameCount, MEMORY_HISTORY))
+            return FrameMemory{};
+        return history[(frameCount - 1 - ago) % MEMORY_HISTORY];
+    }
+
+    // Allocations since the last FrameMark().
+    static FrameMemory Current() {
+        return FrameMemory{frameHeapAllocations.load(std::memory_order_relaxed),
+                           frameHeapBytes.load(std::memory_order_relaxed),
+                           frameArenaAllocations.load(std::memory_order_relaxed),
+                           frameArenaBytes.load(std::memory_order_relaxed)};
+    }
+
+    template <typename F>
+    static void ForEachArena(F&& f) {
+        std::lock_guard guard{lock()};
+        for (Arena* arena : arenas()) f(*arena);
+    }
+
+    // Sorted by bytes, most first.
+    static std::vector<AllocationSite> Sites() {
+        std::lock_guard             guard{lock()};
+        std::vector<AllocationSite> result;
+        for (auto& [key, site] : sites()) result.push_back(site);
+        std::sort(result.begin(), result.end(), [](auto& a, auto& b) { return a.bytes > b.bytes; });
+        return result;
+    }
+
+    static bool DumpCsv(const std::string& path = MEMORY_CSV_PATH);
+};
+
 class Arena {
     u8* buffer;
 
    public:
-    usize     size;
-    usize     count = 0;
-    ArenaType type  = Cycle;
-
-    explicit Arena(usize _size) : buffer(new u8[_size]), size(_size) {};
+    usize       size;
+    usize       count = 0;
+    ArenaType   type  = Cycle;
+    const char* name;
+
+    // Telemetry. Relaxed atomics, as the overlay reads them while other threads allocate.
+    std::atomic<usize> highWater{0};  // Most bytes in use at once
+    std::atomic<u64>   allocations{0}, allocated{0};
+    std::atomic<u64>   wraps{0}, overflows{0};  // Times Cycle arenas started over and Throw threw
+    bool ownedByArray = false;  // Made by an Array for itself and never freed, so not registered
+
+    explicit Arena(usize _size, const char* _name = "Arena", bool _ownedByArray = false)
+        : buffer(new u8[_size]), size(_size), name(_name), ownedByArray(_ownedByArray) {
+        if (ownedByArray)
+            MemoryTelemetry::RecordArray(size);
+        else
+            MemoryTelemetry::Register(this);
+    };
     Arena(const Arena&)            = delete;
     Arena& operator=(const Arena&) = delete;
     // Multiple deletes if multiple objects are using/holding the same arena
-    // ~Arena() { delete[] buffer; }
+    ~Arena() {
+        if (!ownedByArray)
+            MemoryTelemetry::Unregister(this);
+    }
 
+    // Aligned for T. A Cycle arena without room left starts over from the beginning, overwriting
+    // whatever was allocated before.
     template <typename T>
-    T* Alloc(usize count = 1) {
-        this->count += sizeof(T) * count;
-        if (this->count >= size)
+    T* Alloc(usize count = 1, std::source_location where = std::source_location::current()) {
+        const usize bytes  = sizeof(T) * count;
+        usize       offset = (this->count + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (offset + bytes > size)
             switch (type) {
                 case Cycle:
-                    Clear();
+                    wraps.fetch_add(1, std::memory_order_relaxed);
+                    offset = 0;
+                    assert(bytes <= size && "Allocation larger than the whole arena");
                     break;
 
                 case Throw:
+                    overflows.fetch_add(1, std::memory_order_relaxed);
                     throw ArenaOverflow();
 
                     // default:
                     //     std::unreachable();
             }
 
-        return reinterpret_cast<T*>(&buffer[this->count]);
+        this->count = offset + bytes;
+        if (this->count > highWater.load(std::memory_order_relaxed))
+            highWater.store(this->count, std::memory_order_relaxed);  // Only the owner writes
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated.fetch_add(bytes, std::memory_order_relaxed);
+        MemoryTelemetry::RecordArena(bytes, where);
+
+        return reinterpret_cast<T*>(&buffer[offset]);
     }
 
     inline void Clear() { count = 0; }
 };
 
+bool MemoryTelemetry::DumpCsv(const std::string& path) {
+    std::ofstream outFile(path);
+    if (!outFile) {
+        std::cout << "ERROR: ENGINE: Error opening file for writing: " << path << "\n";
+        return false;
+    }
+
+    outFile << "kind,name,allocations,bytes,high_water,size,wraps,overflows\n";
+    for (u64 ago = std::min<u64>(frameCount, MEMORY_HISTORY); ago-- > 0;) {
+        const FrameMemory frame = Frame(ago);
+        outFile << "frame_heap," << frameCount - 1 - ago << "," << frame.heapAllocations << ","
+                << frame.heapBytes << ",,,,\n";
+        outFile << "frame_arena," << frameCount - 1 - ago << "," << frame.arenaAllocations << ","
+                << frame.arenaBytes << ",,,,\n";
+    }
+
+    ForEachArena([&](const Arena& arena) {
+        outFile << "arena," << arena.name << "," << arena.allocations.load() << ","
+                << arena.allocated.load() << "," << arena.highWater.load() << "," << arena.size
+                << "," << arena.wraps.load() << "," << arena.overflows.load() << "\n";
+    });
+    outFile << "arena,Arrays (leaked)," << arrayArenas.load() << "," << arrayBytes.load() << ","
+            << arrayBytes.load() << "," << arrayBytes.load() << ",0,0\n";
+
+    for (const AllocationSite& site : Sites())
+        outFile << "site," << fs::path(site.file).filename().string() << ":" << site.line << ","
+                << site.allocations << "," << site.bytes << ",,,,\n";
+
+    outFile << "heap,live," << heapAllocations.load() << "," << heapLive.load() << ","
+            << heapPeak.load() << ",,,\n";
+
+    std::cout << "INFO: ENGINE: Wrote memory telemetry to " << path << "\n";
+    return true;
+}
+
+#if defined(MEMORY_TELEMETRY)
+// Every heap allocation goes through these, with its size stored in front of it so frees can be
+// counted too. Aligned new and delete are left alone.
+#define HEAP_HEADER 16  // Keeps the block aligned for max_align_t
+
+// The header is written and read only in these two, kept out of line: inlined next to a new
+// expression, GCC sees the pointer arithmetic and the free of a block that came from new and warns
+// (-Warray-bounds, -Wmismatched-new-delete).
+[[gnu::noinline]] void* HeapAllocate(usize bytes) {
+    u8* block = (u8*)malloc(bytes + HEAP_HEADER);
+    if (!block)
+        throw std::bad_alloc();
+
+    *(usize*)block = bytes;
+    MemoryTelemetry::RecordHeap(bytes);
+    return block + HEAP_HEADER;
+}
+
+[[gnu::noinline]] void HeapFree(void* pointer) {
+    u8* block = (u8*)pointer - HEAP_HEADER;
+    MemoryTelemetry::RecordFree(*(usize*)block);
+    free(block);
+}
+
+void* operator new(usize bytes) { return HeapAllocate(bytes); }
+void* operator new[](usize bytes) { return operator new(bytes); }
+
+void operator delete(void* pointer) noexcept {
+    if (pointer)
+        HeapFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept { operator delete(pointer); }
+void operator delete(void* pointer, usize) noexcept { operator delete(pointer); }
+void operator delete[](void* pointer, usize) noexcept { operator delete(pointer); }
+#endif
+
 // TODO
 class PackedStringArray {};
 
@@ -131,29 +516,41 @@ template <typename T>
 class Array {
     Arena* arena;
 
+    // Copies share the buffer, so nobody frees it. Telemetry counts these as Array arenas.
+    static Arena* ownArena(usize size) {
+        return new Arena(size * sizeof(T), "Array", true);
+    }
+
    public:
     T*    buffer;  // FIXME Left public for std::sort?
     usize size;
     usize count;
     usize stride = 1;
 
-    explicit Array(std::initializer_list<T> list, Arena* _arena = nullptr)
-        : arena(_arena ? _arena : new Arena(list.size() * sizeof(T))),
-          buffer(arena->Alloc<T>(list.size())),
+    explicit Array(std::initializer_list<T> list,
+                   Arena*                   _arena = nullptr,
+                   std::source_location     where  = std::source_location::current())
+        : arena(_arena ? _arena : ownArena(list.size())),
+          buffer(arena->Alloc<T>(list.size(), where)),
           size(list.size()),
           count(0) {
         for (auto&& elem : list) Push(elem);
     }
 
-    explicit Array(usize _size, Arena* _arena = nullptr)
-        : arena(_arena ? _arena : new Arena(_size * sizeof(T))),
-          buffer(arena->Alloc<T>(_size)),
+    explicit Array(usize                _size,
+                   Arena*               _arena = nullptr,
+                   std::source_location where  = std::source_location::current())
+        : arena(_arena ? _arena : ownArena(_size)),
+          buffer(arena->Alloc<T>(_size, where)),
           size(_size),
           count(0) {};
 
-    explicit Array(usize _size, const T& fill, Arena* _arena = nullptr)
-        : arena(_arena ? _arena : new Arena(_size * sizeof(T))),
-          buffer(arena->Alloc<T>(_size)),
+    explicit Array(usize                _size,
+                   const T&             fill,
+                   Arena*               _arena = nullptr,
+                   std::source_location where  = std::source_location::current())
+        : arena(_arena ? _arena : ownArena(_size)),
+          buffer(arena->Alloc<T>(_size, where)),
           size(_size),
           count(_size) {
         for (usize i = 0; i < count; i++) {
@@ -231,8 +628,9 @@ class Array {
         T min = Min();
         T gap = ceil((max - min) / (count - 1));
 
-        Array<T> min_bucket(count - 1, INT_MAX, &arena);
-        Array<T> max_bucket(count - 1, INT_MIN, &arena);
+        // Not in the array's own arena: it has no room left, and would cycle over the values.
+        std::vector<T> min_bucket(count - 1, INT_MAX);
+        std::vector<T> max_bucket(count - 1, INT_MIN);
 
         for (usize i = 0; i < count; i++) {
             if (buffer[i] == min || buffer[i] == max)
@@ -264,6 +662,15 @@ class ArrayDim : public Array<T> {
     u8 strides[D];
 };
 
+// Seconds that time-dependent code running right now should advance by. Inside a fixed simulation
+// tick (see FixedTimestep) that's the tick length, anywhere else the last frame's time. Per thread,
+// as pipelined scenes tick on a worker while the main thread draws.
+struct SimulationClock {
+    static inline thread_local f32 tick = 0;  // Zero outside of a tick
+
+    static f32 Delta() { return tick > 0 ? tick : GetFrameTime(); }
+};
+
 // Types that satisfy Dampenable may be used as type parameters for Damped<> without causing
 // errors, though it may not make sense to do so (e.g. Damped<bool> satisfies this constraint, even
 // though a damped bool is rather meaningless).
@@ -275,7 +682,74 @@ concept Dampenable = requires(T const& value, f32 const& scalar) {
     { value / scalar } -> std::convertible_to<T>;
 };
 
-// TODO A pool of damped values?
+// Exact discrete step of the damped system below for a fixed delta time. Taking the target as
+// moving linearly within a step, the system's offset from its steady state evolves through a
+// constant 2x2 transition matrix, so stepping is unconditionally stable and needs no clamping.
+struct DampedTransition {
+    f32 a00, a01, a10, a11;  // exp(A * delta) of the homogeneous system
+    f32 k31;                 // k3 - k1: steady state lead over the target per unit target velocity
+    f32 delta;
+
+    static DampedTransition Compute(const f32 f, const f32 z, const f32 r, const f32 delta) {
+        const f64 w  = 2 * PI * (f64)f;
+        const f64 zw = z * w;
+        const f64 t  = delta;
+
+        f64 ex, c, s_wd;  // exp(-zwt), and the cos/sin-like terms, sin-like already divided by wd
+        if (std::abs(z - 1) < 1e-4) {
+            ex   = std::exp(-w * t);
+            c    = 1;
+            s_wd = t;
+        } else if (z < 1) {
+            const f64 wd = w * std::sqrt(1 - (f64)z * z);
+            ex           = std::exp(-zw * t);
+            c            = std::cos(wd * t);
+            s_wd         = std::sin(wd * t) / wd;
+        } else {
+            // Written with both real roots so cosh/sinh don't overflow for large z.
+            const f64 wd   = w * std::sqrt((f64)z * z - 1);
+            const f64 slow = std::exp((-zw + wd) * t);
+            const f64 fast = std::exp((-zw - wd) * t);
+            ex             = 1;
+            c              = (slow + fast) / 2;
+            s_wd           = (slow - fast) / 2 / wd;
+        }
+
+        return DampedTransition{.a00   = f32(ex * (c + zw * s_wd)),
+                                .a01   = f32(ex * s_wd),
+                                .a10   = f32(-ex * w * w * s_wd),
+                                .a11   = f32(ex * (c - zw * s_wd)),
+                                .k31   = f32(r * z / w - 2 * z / w),
+                                .delta = delta};
+    }
+
+    // Transitions are shared between all values with the same parameters.
+    static const DampedTransition& Get(const f32 f, const f32 z, const f32 r, const f32 delta) {
+        static std::map<std::array<f32, 4>, DampedTransition> cache;
+        static std::mutex                                     cacheMutex;
+
+        std::lock_guard lock(cacheMutex);
+        auto [it, inserted] = cache.try_emplace({f, z, r, delta});
+        if (inserted)
+            it->second = Compute(f, z, r, delta);
+
+        return it->second;
+    }
+
+    // Moves y and yd by one step towards target, with xp the target of the previous step.
+    template <typename T>
+    void Step(T& y, T& yd, T& xp, const T& target) const {
+        T xd = (target - xp) / delta;
+        T e  = y - xp - k31 * xd;
+        T ed = yd - xd;
+
+        xp = target;
+        y  = target + k31 * xd + a00 * e + a01 * ed;
+        yd = xd + a10 * e + a11 * ed;
+    }
+};
+
+// See DampedPool for stepping many damped values at once.
 template <Dampenable T>
 class Damped {
     bool enabled = true;
@@ -286,6 +760,8 @@ class Damped {
     f32 k1, k2, k3;
     f32 f, z, r;
 
+    const DampedTransition* fixed = nullptr;
+
     // Sets the starting point of the damping function. Also allows Damped to not fail when starting
     // at frame zero, i.e. when frame delta time is zero.
     T start(T x0) {
@@ -324,6 +800,12 @@ class Damped {
     // When toggled off, target is passed through with no damping. On by default.
     void Toggle() { enabled = !enabled; }
 
+    // Steps exactly by a fixed delta time on every Set() instead of by SimulationClock::Delta(),
+    // e.g. the FixedTimestep tick. Zero goes back to variable delta time.
+    void Fix(const f32 delta) {
+        fixed = delta > 0 ? &DampedTransition::Get(f, z, r, delta) : nullptr;
+    }
+
     // Computes a new damped value tending towards the previous target + offset.
     T By(const T offset) {
         target = target + offset;
@@ -343,7 +825,13 @@ class Damped {
             return y;
         }
 
-        f32 delta = GetFrameTime();
+        if (fixed) {
+            target = newTarget;
+            fixed->Step(y, yd, xp, newTarget);
+            return y;
+        }
+
+        f32 delta = SimulationClock::Delta();
 
         T xd   = (newTarget - xp) / delta;
         xp     = newTarget;
@@ -356,84 +844,295 @@ class Damped {
     }
 };
 
-enum CellState {
-    Dead,
-    Alive,
+// Handle to a value in a DampedPool. Handles are slot indices, not pointers, so they stay valid
+// when the pool grows. Using a handle after Remove() is caught by the generation check.
+template <typename T>
+struct DampedHandle {
+    u32 slot       = UINT32_MAX;
+    u32 generation = 0;
 };
 
-// TODO Cellular Automata GDExtension plugin
-// custom number of states, history, rules, etc etc.
-// Inherits from tilemap?
-struct ConwayBoard {
-    // TODO two copies of board for data-oriented?
-    // And if I add a time dimension to determine the tile to use? What's more data-oriented then?
-    CellState board[64][64];
+// Types that can live in a DampedPool: anything Dampenable made only of f32 components.
+template <typename T>
+concept Poolable =
+    Dampenable<T> && std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(f32) == 0;
+
+// Steps many damped values in a single pass with a shared delta time. Each f32 component of each
+// value is one lane of flat SoA arrays, so Step() is a branchless loop the compiler vectorizes.
+// Same second order system as Damped<T>.
+template <Poolable T>
+class DampedPool {
+    static constexpr usize N = sizeof(T) / sizeof(f32);
+
+    // Per-lane state (x is the target) and coefficients. Lanes of a value are contiguous.
+    std::vector<f32> x, xp, xd, y, yd;
+    std::vector<f32> k1, k2, k3;
+    std::vector<f32> f, z, r;
+
+    // Per-lane DampedTransition, only filled in fixed step mode.
+    std::vector<f32> a00, a01, a10, a11, k31;
+
+    // Slot map: handle slot -> dense index and back.
+    std::vector<u32> denseOf, slotOf, generations, freeSlots;
+
+    f32 maxSubstep  = 0;
+    f32 fixedDelta  = 0;
+    f32 accumulator = 0;
+
+    auto lanes() {
+        return std::array{
+            &x, &xp, &xd, &y, &yd, &k1, &k2, &k3, &f, &z, &r, &a00, &a01, &a10, &a11, &k31};
+    }
 
-    ConwayBoard(Array<v2> initialLiving) /*/: board{}*/ {
-        memset(board, CellState::Dead, sizeof(CellState) * 64 * 64);
+    void fillTransition(const usize i) {
+        const DampedTransition& t = DampedTransition::Get(f[i], z[i], r[i], fixedDelta);
+        a00[i]                    = t.a00;
+        a01[i]                    = t.a01;
+        a10[i]                    = t.a10;
+        a11[i]                    = t.a11;
+        k31[i]                    = t.k31;
+    }
 
-        for (usize i = 0; i < initialLiving.count; i++)
-            board[(usize)initialLiving[i].x][(usize)initialLiving[i].y] = CellState::Alive;
+    usize lane(const DampedHandle<T> handle) const {
+        assert(IsValid(handle));
+        return denseOf[handle.slot] * N;
     }
 
-    void Update() {
-        for (usize i = 1; i < 63; i++)
-            for (usize j = 1; j < 63; j++) {
-                usize near{};
+    void integrate(const f32 delta) {
+        const usize count = y.size();
 
-                for (usize k = i - 1; k < i + 2; k++)
-                    for (usize f = j - 1; f < j + 2; f++)
-                        near += board[k][f] == CellState::Alive ? 1 : 0;
+        f32* __restrict       py  = y.data();
+        f32* __restrict       pyd = yd.data();
+        const f32* __restrict px  = x.data();
+        const f32* __restrict pxd = xd.data();
+        const f32* __restrict pk1 = k1.data();
+        const f32* __restrict pk2 = k2.data();
+        const f32* __restrict pk3 = k3.data();
 
-                // RULES HERE
-                switch (near) {
-                    case 0:
-                        break;
+        for (usize i = 0; i < count; i++) {
+            py[i] = py[i] + delta * pyd[i];
 
-                    case 1:
-                        break;
+            f32 k2_stable = std::max(pk2[i], 1.1f * (delta * delta / 4 + delta * pk1[i] / 2));
+            pyd[i] += delta * (px[i] + pk3[i] * pxd[i] - py[i] - pk1[i] * pyd[i]) / k2_stable;
+        }
+    }
 
-                    case 2:
-                        break;
+    // DampedTransition::Step() over all lanes, a handful of FMAs each.
+    void integrateExact() {
+        const usize count   = y.size();
+        const f32   inverse = 1 / fixedDelta;
+
+        f32* __restrict       py   = y.data();
+        f32* __restrict       pyd  = yd.data();
+        f32* __restrict       pxp  = xp.data();
+        const f32* __restrict px   = x.data();
+        const f32* __restrict p00  = a00.data();
+        const f32* __restrict p01  = a01.data();
+        const f32* __restrict p10  = a10.data();
+        const f32* __restrict p11  = a11.data();
+        const f32* __restrict pk31 = k31.data();
 
-                    case 3:
-                        break;
+        for (usize i = 0; i < count; i++) {
+            f32 xd = (px[i] - pxp[i]) * inverse;
+            f32 e  = py[i] - pxp[i] - pk31[i] * xd;
+            f32 ed = pyd[i] - xd;
 
-                    default:
-                        break;
-                }
-            }
+            pxp[i] = px[i];
+            py[i]  = px[i] + pk31[i] * xd + p00[i] * e + p01[i] * ed;
+            pyd[i] = xd + p10[i] * e + p11[i] * ed;
+        }
+    }
+
+   public:
+    explicit DampedPool(const usize reserve = 0) {
+        for (auto* lane : lanes()) lane->reserve(reserve * N);
+    }
+
+    usize Count() const { return slotOf.size(); }
+
+    bool IsValid(const DampedHandle<T> handle) const {
+        return handle.slot < denseOf.size() && generations[handle.slot] == handle.generation &&
+               denseOf[handle.slot] != UINT32_MAX;
     }
 
-    void Draw() {}
+    // Adds a value resting at x0.
+    DampedHandle<T> Add(const T x0, const f32 _f = 1, const f32 _z = 1, const f32 _r = 0) {
+        u32 slot;
+        if (freeSlots.empty()) {
+            slot = (u32)denseOf.size();
+            denseOf.push_back(0);
+            generations.push_back(0);
+        } else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        denseOf[slot] = (u32)slotOf.size();
+        slotOf.push_back(slot);
+
+        f32 components[N];
+        memcpy(components, &x0, sizeof(T));
+        for (usize i = 0; i < N; i++) {
+            for (auto* lane : lanes()) lane->push_back(0);
+
+            x.back()  = components[i];
+            xp.back() = components[i];
+            y.back()  = components[i];
+            k1.back() = _z / (PI * _f);
+            k2.back() = 1 / powf(2 * PI * _f, 2);
+            k3.back() = _r * _z / (2 * PI * _f);
+            f.back()  = _f;
+            z.back()  = _z;
+            r.back()  = _r;
+
+            if (fixedDelta > 0)
+                fillTransition(x.size() - 1);
+        }
+
+        return DampedHandle<T>{slot, generations[slot]};
+    }
+
+    // Removes a value by moving the last one into its lanes. Other handles are unaffected.
+    void Remove(const DampedHandle<T> handle) {
+        assert(IsValid(handle));
+        const u32 dense = denseOf[handle.slot];
+        const u32 last  = (u32)slotOf.size() - 1;
+
+        for (auto* lane : lanes()) {
+            std::copy_n(lane->begin() + last * N, N, lane->begin() + dense * N);
+            lane->resize(last * N);
+        }
+
+        slotOf[dense]          = slotOf[last];
+        denseOf[slotOf[dense]] = dense;
+        slotOf.pop_back();
+
+        denseOf[handle.slot] = UINT32_MAX;
+        generations[handle.slot]++;
+        freeSlots.push_back(handle.slot);
+    }
+
+    T Value(const DampedHandle<T> handle) const {
+        T result;
+        memcpy(&result, &y[lane(handle)], sizeof(T));
+        return result;
+    }
+
+    T Target(const DampedHandle<T> handle) const {
+        T result;
+        memcpy(&result, &x[lane(handle)], sizeof(T));
+        return result;
+    }
+
+    // Sets a new target. The value moves towards it on the next Step().
+    void Set(const DampedHandle<T> handle, const T newTarget) {
+        memcpy(&x[lane(handle)], &newTarget, sizeof(T));
+    }
+
+    void By(const DampedHandle<T> handle, const T offset) {
+        Set(handle, Target(handle) + offset);
+    }
+
+    // Snaps a value and its target to x0, with no velocity.
+    void Reset(const DampedHandle<T> handle, const T x0) {
+        const usize i = lane(handle);
+        memcpy(&x[i], &x0, sizeof(T));
+        memcpy(&xp[i], &x0, sizeof(T));
+        memcpy(&y[i], &x0, sizeof(T));
+        std::fill_n(&yd[i], N, 0.0f);
+    }
+
+    // Splits each Step() into substeps no longer than maxStep, which keeps stiff springs stable
+    // at low frame rates. Zero disables substepping.
+    void SetSubstep(const f32 maxStep) { maxSubstep = maxStep; }
+
+    // Steps exactly with DampedTransition in fixed increments of delta, accumulating the time
+    // passed to Step(). Overrides substepping. Zero goes back to variable delta time.
+    void SetFixedStep(const f32 delta) {
+        fixedDelta  = delta;
+        accumulator = 0;
+        if (fixedDelta > 0)
+            for (usize i = 0; i < x.size(); i++) fillTransition(i);
+    }
+
+    // Advances every value in the pool by delta seconds.
+    void Step(const f32 delta = SimulationClock::Delta()) {
+        if (delta <= 0)
+            return;
+
+        if (fixedDelta > 0) {
+            // Bounded so a long stall doesn't turn into a burst of steps.
+            accumulator = std::min(accumulator + delta, 8 * fixedDelta);
+            for (; accumulator >= fixedDelta; accumulator -= fixedDelta) integrateExact();
+            return;
+        }
+
+        // The target velocity is estimated once per frame; substeps only subdivide integration.
+        for (usize i = 0; i < x.size(); i++) {
+            xd[i] = (x[i] - xp[i]) / delta;
+            xp[i] = x[i];
+        }
+
+        const u32 steps = maxSubstep > 0 ? (u32)std::ceil(delta / maxSubstep) : 1;
+        for (u32 i = 0; i < steps; i++) integrate(delta / steps);
+    }
 };
 
-struct Edge {
-    v2 p, q;
+template <Point2D P>
+struct EdgeT {
+    P p, q;
 
-    f32  AngleTo(Edge l) const;
-    bool Intersects(Edge l) const;
+    RealOf<P> AngleTo(EdgeT l) const;
+    bool      Intersects(EdgeT l) const;
 };
 
+typedef EdgeT<v2> Edge;
+
 namespace vec2 {
 
-f32 DistanceTo(const v2& p, const v2& q) {
-    return std::sqrt(std::pow((q.x - p.x), 2) + std::pow((q.y - p.y), 2));
+template <Point2D P>
+RealOf<P> DistanceTo(const P& p, const P& q) {
+    using Traits = TraitsOf<P>;
+    const RealOf<P> dx = Traits::ToReal(q.x) - Traits::ToReal(p.x);
+    const RealOf<P> dy = Traits::ToReal(q.y) - Traits::ToReal(p.y);
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// Squared length of q - p, exact for the integer types.
+template <Point2D P>
+typename TraitsOf<P>::Wide DistanceSquared(const P& p, const P& q) {
+    using Traits                   = TraitsOf<P>;
+    const typename Traits::Wide dx = Traits::Widen(q.x) - Traits::Widen(p.x);
+    const typename Traits::Wide dy = Traits::Widen(q.y) - Traits::Widen(p.y);
+    return dx * dx + dy * dy;
 }
 
-bool IsLeft(const v2 p, const v2 q) {
-    return (p.x - q.x) * (p.y - q.y) - (p.y - q.y) * (p.x - q.x) > 0;
+// Twice the signed area of the triangle b, a, p: positive when p is left of the line from a to b
+// as IsLeft() sees it, zero when the three are in line. Exact for the integer types.
+template <Point2D P>
+typename TraitsOf<P>::Wide Cross(const P& p, const P& a, const P& b) {
+    using Traits = TraitsOf<P>;
+    return (Traits::Widen(a.x) - Traits::Widen(b.x)) * (Traits::Widen(p.y) - Traits::Widen(b.y)) -
+           (Traits::Widen(a.y) - Traits::Widen(b.y)) * (Traits::Widen(p.x) - Traits::Widen(b.x));
 }
 
-bool IsLeft(const v2 p, const Edge l) {
-    return (l.p.x - l.q.x) * (p.y - l.q.y) - (l.p.y - l.q.y) * (p.x - l.q.x) > 0;
+template <Point2D P>
+bool IsLeft(const P p, const P q) {
+    return Cross(p, p, q) > 0;
 }
 
-bool IsLeft(const v2 p, const v2& a, const v2& b) {
-    return (a.x - b.x) * (p.y - b.y) - (a.y - b.y) * (p.x - b.x) > 0;
+template <Point2D P>
+bool IsLeft(const P p, const EdgeT<P> l) {
+    return Cross(p, l.p, l.q) > 0;
 }
 
-bool IsInTriangle(const v2 p, const v2 q, const v2 r) {
+template <Point2D P>
+bool IsLeft(const P p, const P& a, const P& b) {
+    return Cross(p, a, b) > 0;
+}
+
+template <Point2D P>
+bool IsInTriangle(const P p, const P q, const P r) {
     return IsLeft(p, q) && IsLeft(q, r) && IsLeft(r, p);
 }
 
@@ -483,95 +1182,120 @@ bool Intersects(const v2& p_pos, const u32 p_radius, const v2& q_pos, const u32
 
 }  // namespace circle2
 
-f32 Edge::AngleTo(const Edge l) const {
-    return atan2(l.q.y - l.p.y, l.q.x - l.p.x) - atan2(q.y - p.y, q.x - p.x);
+template <Point2D P>
+RealOf<P> EdgeT<P>::AngleTo(const EdgeT l) const {
+    using Traits = TraitsOf<P>;
+    return std::atan2(Traits::ToReal(l.q.y) - Traits::ToReal(l.p.y),
+                      Traits::ToReal(l.q.x) - Traits::ToReal(l.p.x)) -
+           std::atan2(Traits::ToReal(q.y) - Traits::ToReal(p.y),
+                      Traits::ToReal(q.x) - Traits::ToReal(p.x));
 }
 
-bool Edge::Intersects(const Edge l) const {
+template <Point2D P>
+bool EdgeT<P>::Intersects(const EdgeT l) const {
     return vec2::IsLeft(l.p, *this) != vec2::IsLeft(l.q, *this) &&
            vec2::IsLeft(p, l) != vec2::IsLeft(q, l);
 }
 
 namespace mesh {
 
-v2 Centroid(const Array<v2>& mesh) {
-    v2 result{};
+template <Point2D P>
+P Centroid(const Array<P>& mesh) {
+    using Traits = TraitsOf<P>;
+    typename Traits::Wide x{}, y{};
 
     for (usize i = 0; i < mesh.count; i++) {
-        result.x += mesh[i].x;
-        result.y += mesh[i].y;
+        x += Traits::Widen(mesh[i].x);
+        y += Traits::Widen(mesh[i].y);
     }
 
-    result.x /= mesh.count;
-    result.y /= mesh.count;
-
-    return result;
+    return P{Traits::Narrow(x / (typename Traits::Wide)mesh.count),
+             Traits::Narrow(y / (typename Traits::Wide)mesh.count)};
 }
 
-v2 Centroid(const Array<Edge>& mesh) {
-    v2 result{};
+// Of the corners of a closed loop, like the hulls: each edge starts at one.
+template <Point2D P>
+P Centroid(const Array<EdgeT<P>>& mesh) {
+    using Traits = TraitsOf<P>;
+    typename Traits::Wide x{}, y{};
 
-    for (usize i = 0; i < mesh.count - 1; i++) {
-        result.x += mesh[i].p.x;
-        result.y += mesh[i].p.x;
+    for (usize i = 0; i < mesh.count; i++) {
+        x += Traits::Widen(mesh[i].p.x);
+        y += Traits::Widen(mesh[i].p.y);
     }
 
-    result.x /= mesh.count;
-    result.y /= mesh.count;
-
-    return result;
+    return P{Traits::Narrow(x / (typename Traits::Wide)mesh.count),
+             Traits::Narrow(y / (typename Traits::Wide)mesh.count)};
 }
 
 }  // namespace mesh
 
-struct Circle {
-    f32 x;
-    f32 y;
-    f32 r;
-    Circle() {}
-    Circle(f32 x, f32 y, f32 r) : x(x), y(y), r(r) {}
-    Circle(v2 xy, f32 r) : x(xy.x), y(xy.y), r(r) {}
+template <typename T>
+struct CircleT {
+    T x;
+    T y;
+    T r;
+    CircleT() {}
+    CircleT(T x, T y, T r) : x(x), y(y), r(r) {}
+    template <Point2D P>
+    CircleT(P xy, T r) : x(TraitsOf<P>::ToReal(xy.x)), y(TraitsOf<P>::ToReal(xy.y)), r(r) {}
 };
 
-Circle _EnclosingDisk(Array<v2> const& R) {
+typedef CircleT<f32> Circle;
+
+template <Point2D P>
+CircleT<RealOf<P>> _EnclosingDisk(Array<P> const& R) {
+    using Traits = TraitsOf<P>;
+    using Real   = RealOf<P>;
+
     switch (R.count) {
         case 0:
-            return Circle(0, 0, -1);
+            return CircleT<Real>(0, 0, -1);
 
         case 1:
-            return Circle(R[0].x, R[0].y, 0);
-
-        case 2:
-            return Circle((R[0].x + R[1].x) / 2.0,
-                          (R[0].y + R[1].y) / 2.0,
-                          hypot(R[0].x - R[1].x, R[0].y - R[1].y) / 2.0);
-
-        default:
-            f32 D = (R[0].x - R[2].x) * (R[1].y - R[2].y) - (R[1].x - R[2].x) * (R[0].y - R[2].y);
-            f32 p0 =
-                (((R[0].x - R[2].x) * (R[0].x + R[2].x) + (R[0].y - R[2].y) * (R[0].y + R[2].y)) /
-                     2 * (R[1].y - R[2].y) -
-                 ((R[1].x - R[2].x) * (R[1].x + R[2].x) + (R[1].y - R[2].y) * (R[1].y + R[2].y)) /
-                     2 * (R[0].y - R[2].y)) /
-                D;
-            f32 p1 =
-                (((R[1].x - R[2].x) * (R[1].x + R[2].x) + (R[1].y - R[2].y) * (R[1].y + R[2].y)) /
-                     2 * (R[0].x - R[2].x) -
-                 ((R[0].x - R[2].x) * (R[0].x + R[2].x) + (R[0].y - R[2].y) * (R[0].y + R[2].y)) /
-                     2 * (R[1].x - R[2].x)) /
-                D;
-            return Circle(p0, p1, hypot(R[0].x - p0, R[0].y - p1));
-    }
-}
-
-Circle _EnclosingDisk(Array<v2>& P, usize i, Array<v2> R) {
-    if (i == P.count || R.count == 3)
+            return CircleT<Real>(R[0], 0);
+
+        case 2: {
+            const Real x0 = Traits::ToReal(R[0].x), y0 = Traits::ToReal(R[0].y);
+            const Real x1 = Traits::ToReal(R[1].x), y1 = Traits::ToReal(R[1].y);
+            return CircleT<Real>((x0 + x1) / 2, (y0 + y1) / 2, std::hypot(x0 - x1, y0 - y1) / 2);
+        }
+
+        default: {
+            // Circumcircle, relative to the third point.
+            const Real x2 = Traits::ToReal(R[2].x), y2 = Traits::ToReal(R[2].y);
+            const Real ax = Traits::ToReal(R[0].x) - x2, ay = Traits::ToReal(R[0].y) - y2;
+            const Real bx = Traits::ToReal(R[1].x) - x2, by = Traits::ToReal(R[1].y) - y2;
+
+            const Real D = ax * by - bx * ay;
+            if (D == 0) {
+                // In line, or two in the same place: the disk of the two farthest apart.
+                const Real ab = std::hypot(ax - bx, ay - by);
+                const Real a  = std::hypot(ax, ay), b = std::hypot(bx, by);
+                if (ab >= a && ab >= b)
+                    return CircleT<Real>(x2 + (ax + bx) / 2, y2 + (ay + by) / 2, ab / 2);
+                if (a >= b)
+                    return CircleT<Real>(x2 + ax / 2, y2 + ay / 2, a / 2);
+                return CircleT<Real>(x2 + bx / 2, y2 + by / 2, b / 2);
+            }
+
+            const Real a2 = (ax * ax + ay * ay) / 2, b2 = (bx * bx + by * by) / 2;
+            const Real cx = (a2 * by - b2 * ay) / D, cy = (b2 * ax - a2 * bx) / D;
+            return CircleT<Real>(x2 + cx, y2 + cy, std::hypot(ax - cx, ay - cy));
+        }
+    }
+}
+
+template <Point2D P>
+CircleT<RealOf<P>> _EnclosingDisk(Array<P>& points, usize i, Array<P> R) {
+    using Traits = TraitsOf<P>;
+    if (i == points.count || R.count == 3)
         return _EnclosingDisk(R);
 
-    Circle D = _EnclosingDisk(P, i + 1, R);
-    if (hypot(P[i].x - D.x, P[i].y - D.y) > D.r) {
-        R.Push(P[i]);
-        D = _EnclosingDisk(P, i + 1, R);
+    CircleT<RealOf<P>> D = _EnclosingDisk(points, i + 1, R);
+    if (std::hypot(Traits::ToReal(points[i].x) - D.x, Traits::ToReal(points[i].y) - D.y) > D.r) {
+        R.Push(points[i]);
+        D = _EnclosingDisk(points, i + 1, R);
     }
     return D;
 }
@@ -579,115 +1303,102 @@ Circle _EnclosingDisk(Array<v2>& P, usize i, Array<v2> R) {
 // Welzl's smallest enclosing disk algorithm
 // fails if two points are in the same place
 // points should ideally be randomly shuffled.
-Circle EnclosingDisk(Array<v2> P) {
-    static Arena EnclosingDiskArena(DEFAULT_ARENA_SIZE);
-    return _EnclosingDisk(P, 0, Array<v2>(P.size, &EnclosingDiskArena));
+// In Real of the points: f32 for v2, f64 for the rest.
+template <Point2D P>
+CircleT<RealOf<P>> EnclosingDisk(Array<P> points) {
+    static Arena EnclosingDiskArena(DEFAULT_ARENA_SIZE, "Enclosing disk");
+    EnclosingDiskArena.Clear();
+    return _EnclosingDisk(points, 0, Array<P>(3, &EnclosingDiskArena));
 }
 
-Array<Edge> ConvexHull_ExtremeEdges(const Array<v2>& points) {
-    usize       size = 40;
-    Array<Edge> result(size);
-    usize       count = 0;
+// Every edge with no point left of it, nor in line with it past either end. O(n^3). The edges
+// come out unordered, from the caller's arena.
+template <Point2D P>
+Array<EdgeT<P>> ConvexHull_ExtremeEdges(const Array<P>& points, Arena& arena) {
+    // A hull has no more edges than points.
+    Array<EdgeT<P>> result(points.count, &arena);
+
+    // Repeated points only count the first time, or their edges would repeat too.
+    const auto repeated = [&points](usize index) {
+        for (usize i = 0; i < index; ++i)
+            if (memcmp(&points[i], &points[index], sizeof(P)) == 0)
+                return true;
+        return false;
+    };
 
     for (usize i = 0; i < points.count; ++i) {
+        if (repeated(i))
+            continue;
+
         for (usize j = 0; j < points.count; ++j) {
-            if (memcmp(&points[i], &points[j], sizeof(v2)) == 0)
+            if (memcmp(&points[i], &points[j], sizeof(P)) == 0 || repeated(j))
                 continue;
 
-            const Edge toTest    = Edge{points[i], points[j]};
-            bool       isExtreme = true;
+            const EdgeT<P> toTest    = EdgeT<P>{points[i], points[j]};
+            bool           isExtreme = true;
 
             for (usize k = 0; k < points.count; ++k) {
-                if (memcmp(&points[k], &toTest.p, sizeof(v2)) == 0)
+                if (memcmp(&points[k], &toTest.p, sizeof(P)) == 0)
                     continue;
-                if (memcmp(&points[k], &toTest.q, sizeof(v2)) == 0)
+                if (memcmp(&points[k], &toTest.q, sizeof(P)) == 0)
                     continue;
 
-                // TODO: tmb chequear si cloud[k] esta en la linea pq
-
-                if (vec2::IsLeft(points[k], toTest)) {
+                const auto cross = vec2::Cross(points[k], toTest.p, toTest.q);
+                if (cross > 0)
                     isExtreme = false;
-                    break;
+                if (cross == 0) {
+                    // In line but past either end: the edge is only part of a longer one.
+                    const auto length = vec2::DistanceSquared(toTest.p, toTest.q);
+                    if (vec2::DistanceSquared(points[k], toTest.p) > length ||
+                        vec2::DistanceSquared(points[k], toTest.q) > length)
+                        isExtreme = false;
                 }
+                if (!isExtreme)
+                    break;
             }
 
-            if (isExtreme) {
+            // Rounding can make a float edge look extreme when it's not: never more than fits.
+            if (isExtreme && result.count < result.size)
                 result.Push(toTest);
-
-                // if ring is closed
-                if (memcmp(&result[count].q, &result[0].p, sizeof(v2)) == 0)
-                    return result;
-                // break?
-            }
         }
     }
 
     return result;
 };
 
-Array<Edge> ConvexHull_JarvisMarch(const Array<v2>& points) {
-    usize       size = 40;  // TODO
-    Array<Edge> result(size);
-
-    // TODO: Degenerate case (multiple mins)
-    std::sort(&points.buffer[0], &points.buffer[points.count], [](const v2 a, const v2 b) {
-        return a.x > b.x;
-    });
-
-    usize i = 0;
-    for (usize j = 0; j < points.count; ++j) {
-        if (memcmp(&points[i], &points[j], sizeof(v2)) == 0)
-            continue;
-
-        // TODO: optimizar copy
-        const Edge toTest    = Edge{points[i], points[j]};
-        bool       isExtreme = true;
-
-        for (usize k = 0; k < points.count; ++k) {
-            if (memcmp(&points[k], &toTest.p, sizeof(v2)) == 0)
-                continue;
-            if (memcmp(&points[k], &toTest.q, sizeof(v2)) == 0)
-                continue;
-
-            // TODO: tmb chequear si cloud[k] esta en la linea pq
+// Gift wrapping from the rightmost point, the one with the highest y if several are: a corner,
+// never the middle of an edge the wrap wouldn't come back to. Each step takes the point with
+// nobody left of the edge to it, the farthest one if several are in line, so it only needs the
+// exact Cross() and no angles. The edges come from the caller's arena.
+template <Point2D P>
+Array<EdgeT<P>> ConvexHull_JarvisMarch(const Array<P>& points, Arena& arena) {
+    // A hull has no more edges than points.
+    Array<EdgeT<P>> result(std::max<usize>(points.count, 2), &arena);
+    if (points.count < 2)
+        return result;
 
-            if (vec2::IsLeft(points[k], toTest)) {
-                isExtreme = false;
-                break;
-            }
-        }
-
-        if (isExtreme) {
-            result.Push(toTest);
-            i = j;
-            break;
-        }
-    }
+    usize start = 0;
+    for (usize i = 1; i < points.count; ++i)
+        if (points[i].x > points[start].x ||
+            (points[i].x == points[start].x && points[i].y > points[start].y))
+            start = i;
 
+    usize i = start;
     do {
-        f64   smallest_angle = INT_MAX;
-        usize smallest_j     = 0;
-        for (usize j = 0; j < points.count; ++j) {
-            if (memcmp(&points[i], &points[j], sizeof(v2)) == 0)
+        usize next = i == 0 ? 1 : 0;
+        for (usize k = 0; k < points.count; ++k) {
+            if (memcmp(&points[k], &points[i], sizeof(P)) == 0)
                 continue;
 
-            // TODO: optimizar copy
-            const Edge toTest = Edge{points[i], points[j]};
-
-            f64 angle = result[result.count - 1].AngleTo(toTest);
-            if (angle < 0)
-                angle += 2 * PI;  // ???
-
-            // TODO: Degenerate case (point in same line as ij)
-            if (angle < smallest_angle) {
-                smallest_angle = angle;
-                smallest_j     = j;
-            }
+            const auto cross = vec2::Cross(points[k], points[i], points[next]);
+            if (cross > 0 || (cross == 0 && vec2::DistanceSquared(points[i], points[k]) >
+                                                vec2::DistanceSquared(points[i], points[next])))
+                next = k;
         }
 
-        result.Push(Edge{result[result.count - 1].q, points[smallest_j]});
-        i = smallest_j;
-    } while (memcmp(&points[0], &result[result.count - 1].q, sizeof(v2)) != 0);
+        result.Push(EdgeT<P>{points[i], points[next]});
+        i = next;
+    } while (memcmp(&points[start], &points[i], sizeof(P)) != 0 && result.count < result.size);
 
     return result;
 }
@@ -696,32 +1407,38 @@ Array<Edge> ConvexHull_JarvisMarch(const Array<v2>& points) {
 // sorted array for points
 // O(n) graham scan
 // updatable convex hull / bounding box / bounding circle
-static Arena convexHullArena(DEFAULT_ARENA_SIZE);
-Array<Edge>  ConvexHull_GrahamScan(const Array<v2>& points) {
+// Results are only valid until the next call.
+static Arena convexHullArena(4 * DEFAULT_ARENA_SIZE, "Convex hull");
+template <Point2D P>
+Array<EdgeT<P>> ConvexHull_GrahamScan(const Array<P>& points) {
     // Array<v2> points = basePoints;
+    convexHullArena.Clear();
 
-    v2 first{FLT_MAX, 0};
-    for (usize i = 0; i < points.count; ++i) {
-        if (points[i].x < first.x) {
+    // Lowest x, then lowest y.
+    P first = points[0];
+    for (usize i = 1; i < points.count; ++i) {
+        if (points[i].x < first.x || (points[i].x == first.x && points[i].y < first.y)) {
             first = points[i];
         }
     }
 
     // Ordenar puntos por angulo polar respecto de first
-    // TODO mejor ordenar por X y comparar con un punto al infinito?
-    Edge horizontal = Edge{first, v2{first.x + 1, first.y}};
-    std::sort(&points.buffer[0],
-              &points.buffer[points.count],
-              [first, horizontal](const v2& a, const v2& b) {
-                  if (memcmp(&a, &first, sizeof(v2)) == 0)
-                      return true;
-                  if (memcmp(&b, &first, sizeof(v2)) == 0)
-                      return false;
-
-                  return horizontal.AngleTo(Edge{first, a}) > horizontal.AngleTo(Edge{first, b});
-              });
+    // Every point is right of first or straight up from it, less than half a turn apart, so the
+    // cross product orders them by angle without trig. Points in line with first go nearest first:
+    // the scan pops the nearer ones on reaching the farthest, which also ends the last ray.
+    std::sort(&points.buffer[0], &points.buffer[points.count], [first](const P& a, const P& b) {
+        if (memcmp(&b, &first, sizeof(P)) == 0)
+            return false;
+        if (memcmp(&a, &first, sizeof(P)) == 0)
+            return true;
+
+        const auto cross = vec2::Cross(b, a, first);
+        if (cross != 0)
+            return cross < 0;
+        return vec2::DistanceSquared(a, first) < vec2::DistanceSquared(b, first);
+    });
 
-    Array<v2> resPoints(1 + points.count, &convexHullArena);
+    Array<P> resPoints(1 + points.count, &convexHullArena);
 
     resPoints.Push(points[0]);
     resPoints.Push(points[1]);
@@ -729,7 +1446,9 @@ Array<Edge>  ConvexHull_GrahamScan(const Array<v2>& points) {
     // Graham scan main loop
     usize i = 2;
     while (i < points.count) {
-        if (vec2::IsLeft(
+        // Points in line with first can pop everything but it.
+        if (resPoints.count < 2 ||
+            vec2::IsLeft(
                 points[i], resPoints[resPoints.count - 2], resPoints[resPoints.count - 1])) {
             resPoints.Push(points[i]);
             i++;
@@ -741,51 +1460,193 @@ Array<Edge>  ConvexHull_GrahamScan(const Array<v2>& points) {
     resPoints.Push(points[0]);
 
     // TODO Meh. Can be removed.
-    Array<Edge> result(resPoints.count, &convexHullArena);
+    Array<EdgeT<P>> result(resPoints.count, &convexHullArena);
 
     for (usize j = 0; j < resPoints.count - 1; ++j) {
-        result.Push(Edge{resPoints[j], resPoints[j + 1]});
+        result.Push(EdgeT<P>{resPoints[j], resPoints[j + 1]});
     }
 
     return result;
 };
 
+// Keeps loader(file) of every file in a directory up to date, keyed by path. Changes arrive as
+// inotify events on Linux, elsewhere by polling modification times. A file is reloaded on a
+// background thread once it's been quiet for the debounce time, so a burst of writes loads it once.
+// Finished loads wait until Update() swaps them into loadedData, which makes the frame's safe point
+// the only place data changes and keeps loads off the frame. The loader runs off the main thread,
+// so it must not touch the GPU; the unloader runs on the thread calling Update().
 template <typename T>
 struct FileWatcher {
     const std::string basePath{};
 
-    std::vector<T>                   loadedData;
-    std::vector<fs::directory_entry> filePaths;
-
-    std::vector<fs::file_time_type>              lastModified;
+    std::unordered_map<std::string, T>           loadedData;
     std::function<T(fs::directory_entry const&)> loader;
     std::function<void(T&)>                      unloader;
+    const ch::milliseconds                       debounce;
+
+   private:
+    struct Loaded {
+        std::string      path;
+        std::optional<T> data;  // Empty if the file is gone
+    };
+
+    const fs::path      directory;
+    std::mutex          readyLock;
+    std::vector<Loaded> ready;
+
+    using Clock = ch::steady_clock;
+    std::unordered_map<std::string, Clock::time_point>  pending;   // Watcher thread only
+    std::unordered_map<std::string, fs::file_time_type> modified;  // Watcher thread only, polling
+
+    void load(const std::string& path) {
+        fs::directory_entry entry{path};
+        std::error_code     error;
+
+        Loaded loaded{path, std::nullopt};
+        if (entry.is_regular_file(error))
+            loaded.data = loader(entry);
+
+        std::lock_guard lock{readyLock};
+        ready.push_back(std::move(loaded));
+    }
+
+    void scan() {
+        std::error_code                                     error;
+        std::unordered_map<std::string, fs::file_time_type> seen;
+        for (auto const& file : fs::directory_iterator(directory, error)) {
+            if (!file.is_regular_file(error))
+                continue;
+
+            auto path = file.path().string();
+            auto time = file.last_write_time(error);
+            seen[path] = time;
+
+            auto it = modified.find(path);
+            if (it == modified.end() || it->second != time)
+                pending[path] = Clock::now();
+        }
 
+        for (auto& [path, time] : modified)
+            if (!seen.contains(path))
+                pending[path] = Clock::now();
+        modified = std::move(seen);
+    }
+
+#if defined(FILEWATCHER_INOTIFY)
+    void readEvents(i32 fd) {
+        alignas(inotify_event) char buffer[4096];
+        for (ssize_t length; (length = read(fd, buffer, sizeof(buffer))) > 0;) {
+            for (char* at = buffer; at < buffer + length;) {
+                auto* event = (inotify_event*)at;
+                if (event->len && !(event->mask & IN_ISDIR))
+                    pending[(directory / event->name).string()] = Clock::now();
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+#endif
+
+    void watch(std::stop_token stop) {
+        i32 fd = -1;
+#if defined(FILEWATCHER_INOTIFY)
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        const u32 events = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                           IN_MOVED_TO;
+        if (fd >= 0 && inotify_add_watch(fd, directory.c_str(), events) < 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0)
+            std::cout << "ERROR: ENGINE: inotify unavailable, polling " << directory << "\n";
+#endif
+
+        while (!stop.stop_requested()) {
+#if defined(FILEWATCHER_INOTIFY)
+            if (fd >= 0) {
+                pollfd waiting{fd, POLLIN, 0};
+                if (::poll(&waiting, 1, 50) > 0)
+                    readEvents(fd);
+            }
+#endif
+            if (fd < 0) {
+                std::this_thread::sleep_for(debounce / 2);
+                scan();
+            }
+
+            const auto now = Clock::now();
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (now - it->second < debounce) {
+                    ++it;
+                    continue;
+                }
+                load(it->first);
+                it = pending.erase(it);
+            }
+        }
+
+#if defined(FILEWATCHER_INOTIFY)
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    std::jthread watcher;  // Last, so it stops before the rest goes away
+
+   public:
+    // Loads every file up front, then watches for changes.
     FileWatcher(std::string                                  _basePath,
                 std::function<T(fs::directory_entry const&)> _loader,
-                std::function<void(T&)>                      _unloader)
-        : basePath{_basePath}, loader{_loader}, unloader{_unloader} {
-        usize i = 0;
-        for (auto const& file : fs::directory_iterator(fs::absolute(basePath))) {
-            filePaths.push_back(file);
-            loadedData.push_back(loader(file));
-            lastModified.push_back(file.last_write_time());
-            i++;
+                std::function<void(T&)>                      _unloader,
+                ch::milliseconds                             _debounce = ch::milliseconds(200))
+        : basePath{_basePath},
+          loader{_loader},
+          unloader{_unloader},
+          debounce{_debounce},
+          directory{fs::absolute(basePath)} {
+        for (auto const& file : fs::directory_iterator(directory)) {
+            if (!file.is_regular_file())
+                continue;
+            loadedData.emplace(file.path().string(), loader(file));
+            modified[file.path().string()] = file.last_write_time();
         }
+
+        watcher = std::jthread([this](std::stop_token stop) { watch(stop); });
     }
 
+    FileWatcher(const FileWatcher&)            = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher() {
+        watcher.request_stop();
+        if (watcher.joinable())
+            watcher.join();
+
+        for (auto& loaded : ready)
+            if (loaded.data)
+                unloader(*loaded.data);
+        for (auto& [path, data] : loadedData) unloader(data);
+    }
+
+    // Swaps in whatever finished loading since the last call. Never waits on a load.
     void Update() {
-        usize i = 0;
-        for (auto const& file : fs::directory_iterator(fs::absolute(basePath))) {
-            auto currentModified = file.last_write_time();
-            if (currentModified != lastModified[i]) {
-                printf_s("INFO: Reloading modified file: %s", file.path().c_str());
-
-                unloader(loadedData[i]);
-                loadedData[i]   = loader(file);
-                lastModified[i] = currentModified;
+        std::vector<Loaded> swapped;
+        {
+            std::lock_guard lock{readyLock};
+            swapped.swap(ready);
+        }
+
+        for (auto& loaded : swapped) {
+            auto it = loadedData.find(loaded.path);
+            if (it != loadedData.end()) {
+                unloader(it->second);
+                loadedData.erase(it);
             }
-            i++;
+
+            if (!loaded.data)
+                continue;
+
+            std::cout << "INFO: ENGINE: Reloaded modified file: " << loaded.path << "\n";
+            loadedData.emplace(std::move(loaded.path), std::move(*loaded.data));
         }
     }
 };
@@ -813,36 +1674,342 @@ Collision<T> CastRay(v2 const& from, v2 const& to, C<T> const& colliders, f32 re
     return Collision{.hit = false, .point = v2{}, .shape = T{}};
 }
 
+#define COLUMN_BLOCK_ROWS 65536      // Rows staged per column before a block is written
+#define COLUMN_WRITE_BUFFER (1 << 20)  // Bytes of output gathered before each write to the file
+#define COLUMN_MAGIC 0x534C4F43        // "COLS"
+#define COLUMN_VERSION 1
+
+enum class ColumnType : u8 { U8, U16, U32, U64, I8, I16, I32, I64, F32, F64 };
+
 template <typename T>
-void SaveAsCsv(const char*                           filename,
-               std::initializer_list<const Array<T>> data,
-               const char*                           columns = NULL) {
-    std::ofstream outFile(std::format("../{}", filename));
-    if (!outFile) {
-        std::cerr << "Error opening file: " << filename << "\n";
-        return;
+constexpr ColumnType ColumnTypeOf() {
+    if constexpr (std::is_same_v<T, f32>) return ColumnType::F32;
+    else if constexpr (std::is_same_v<T, f64>) return ColumnType::F64;
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        return sizeof(T) == 1 ? ColumnType::I8
+             : sizeof(T) == 2 ? ColumnType::I16
+             : sizeof(T) == 4 ? ColumnType::I32
+                              : ColumnType::I64;
+    else if constexpr (std::is_integral_v<T>)
+        return sizeof(T) == 1 ? ColumnType::U8
+             : sizeof(T) == 2 ? ColumnType::U16
+             : sizeof(T) == 4 ? ColumnType::U32
+                              : ColumnType::U64;
+    else
+        static_assert(std::is_arithmetic_v<T>, "Columns only hold numbers");
+}
+
+constexpr usize ColumnTypeSize(ColumnType type) {
+    constexpr usize sizes[] = {1, 2, 4, 8, 1, 2, 4, 8, 4, 8};
+    return sizes[(u8)type];
+}
+
+struct Column {
+    std::string name;
+    ColumnType  type = ColumnType::F64;
+};
+
+enum class ColumnFormat { Csv, Binary };
+
+// Streams columns of numbers to a file, as CSV or as binary blocks of columns. Values are staged
+// per column and written out a block at a time, formatted with to_chars into a buffer that goes to
+// the file in large writes. Columns may be of different lengths: CSV leaves the missing cells of a
+// block empty, and binary blocks store each column's count.
+//
+// Binary layout, in the byte order of the machine writing it:
+//   u32 COLUMN_MAGIC, u32 COLUMN_VERSION, u32 column count
+//   Per column: u8 ColumnType, u16 name length, name
+//   Blocks until the end of the file, each with, per column: u64 count, then count values
+//
+// In append mode an existing file with the same columns is carried on from its end, so a dump can
+// grow across frames or runs. A file with different columns is started over.
+class ColumnWriter {
+    std::string                  path;
+    std::vector<Column>          columns;
+    ColumnFormat                 format;
+    std::ofstream                outFile;
+    std::vector<std::vector<u8>> staged;    // Per column, values not written yet
+    std::vector<usize>           consumed;  // Per column, bytes of staged written but still there
+    std::vector<char>            buffer;  // Output not written yet
+
+    void put(const void* data, usize bytes) {
+        const char* from = (const char*)data;
+        buffer.insert(buffer.end(), from, from + bytes);
+        if (buffer.size() >= COLUMN_WRITE_BUFFER)
+            flushBuffer();
+    }
+
+    template <typename T>
+    void put(const T& value) {
+        put(&value, sizeof(T));
+    }
+
+    void flushBuffer() {
+        outFile.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    std::string header() const {
+        std::string header;
+        if (format == ColumnFormat::Csv) {
+            for (usize c = 0; c < columns.size(); c++)
+                header += (c ? "," : "") + columns[c].name;
+            return header + "\n";
+        }
+
+        const u32 fields[3] = {COLUMN_MAGIC, COLUMN_VERSION, (u32)columns.size()};
+        header.append((const char*)fields, sizeof(fields));
+        for (const Column& column : columns) {
+            const u16 length = column.name.size();
+            header += (char)column.type;
+            header.append((const char*)&length, sizeof(length));
+            header += column.name;
+        }
+        return header;
+    }
+
+    template <typename T>
+    static char* formatCell(char* first, char* last, const u8* raw) {
+        T value;
+        memcpy(&value, raw, sizeof(T));
+        return std::to_chars(first, last, value).ptr;
+    }
+
+    void putCell(ColumnType type, const u8* raw) {
+        char  cell[32];
+        char* end = cell;
+        switch (type) {
+            case ColumnType::U8: end = formatCell<u8>(cell, cell + 32, raw); break;
+            case ColumnType::U16: end = formatCell<u16>(cell, cell + 32, raw); break;
+            case ColumnType::U32: end = formatCell<u32>(cell, cell + 32, raw); break;
+            case ColumnType::U64: end = formatCell<u64>(cell, cell + 32, raw); break;
+            case ColumnType::I8: end = formatCell<i8>(cell, cell + 32, raw); break;
+            case ColumnType::I16: end = formatCell<i16>(cell, cell + 32, raw); break;
+            case ColumnType::I32: end = formatCell<i32>(cell, cell + 32, raw); break;
+            case ColumnType::I64: end = formatCell<i64>(cell, cell + 32, raw); break;
+            case ColumnType::F32: end = formatCell<f32>(cell, cell + 32, raw); break;
+            case ColumnType::F64: end = formatCell<f64>(cell, cell + 32, raw); break;
+        }
+        put(cell, end - cell);
+    }
+
+    template <typename From, typename To>
+    void stageAs(usize column, From value) {
+        const To converted = (To)value;
+        put(staged[column], converted);
+    }
+
+    template <typename T>
+    static void put(std::vector<u8>& into, const T& value) {
+        const u8* from = (const u8*)&value;
+        into.insert(into.end(), from, from + sizeof(T));
+    }
+
+    template <typename T>
+    void stage(usize column, T value) {
+        switch (columns[column].type) {
+            case ColumnType::U8: stageAs<T, u8>(column, value); break;
+            case ColumnType::U16: stageAs<T, u16>(column, value); break;
+            case ColumnType::U32: stageAs<T, u32>(column, value); break;
+            case ColumnType::U64: stageAs<T, u64>(column, value); break;
+            case ColumnType::I8: stageAs<T, i8>(column, value); break;
+            case ColumnType::I16: stageAs<T, i16>(column, value); break;
+            case ColumnType::I32: stageAs<T, i32>(column, value); break;
+            case ColumnType::I64: stageAs<T, i64>(column, value); break;
+            case ColumnType::F32: stageAs<T, f32>(column, value); break;
+            case ColumnType::F64: stageAs<T, f64>(column, value); break;
+        }
     }
 
-    if (columns != NULL) {
-        outFile << columns << ",\n";
-    } else {
-        for (usize i = 0; i < data.size(); i++) {
-            outFile << "Value" << i << ",";
+    usize stagedCount(usize column) const {
+        return (staged[column].size() - consumed[column]) / ColumnTypeSize(columns[column].type);
+    }
+
+    // Drops what's been written from the front of each column. Once per Flush(): doing it per
+    // block would move a long column's rest over and over.
+    void compact() {
+        for (usize c = 0; c < columns.size(); c++) {
+            staged[c].erase(staged[c].begin(), staged[c].begin() + consumed[c]);
+            consumed[c] = 0;
         }
-        outFile << "\n";
     }
 
-    Array<usize> sizes(data.size());
-    for (auto& array : data) {
-        sizes.Push(array.count);
+    // Binary blocks hold whatever each column has staged. A CSV row needs a value from every
+    // column, so only the rows all columns have are written and the rest stay staged, unless pad:
+    // then shorter columns get empty cells, which is only right at the end of the file.
+    void flushBlock(bool pad = false) {
+        if (format == ColumnFormat::Binary) {
+            usize rows = 0;
+            for (usize c = 0; c < columns.size(); c++) rows = std::max(rows, stagedCount(c));
+            if (rows == 0)
+                return;
+
+            for (usize c = 0; c < columns.size(); c++) {
+                put((u64)stagedCount(c));
+                put(staged[c].data() + consumed[c], staged[c].size() - consumed[c]);
+                staged[c].clear();
+                consumed[c] = 0;
+            }
+            return;
+        }
+
+        usize rows = pad ? 0 : SIZE_MAX;
+        for (usize c = 0; c < columns.size(); c++)
+            rows = pad ? std::max(rows, stagedCount(c)) : std::min(rows, stagedCount(c));
+        if (rows == 0 || rows == SIZE_MAX)
+            return;
+
+        for (usize row = 0; row < rows; row++) {
+            for (usize c = 0; c < columns.size(); c++) {
+                if (c)
+                    put(",", 1);
+                if (row < stagedCount(c))
+                    putCell(columns[c].type,
+                            &staged[c][consumed[c] + row * ColumnTypeSize(columns[c].type)]);
+            }
+            put("\n", 1);
+        }
+
+        for (usize c = 0; c < columns.size(); c++) {
+            consumed[c] += std::min(rows, stagedCount(c)) * ColumnTypeSize(columns[c].type);
+            if (consumed[c] == staged[c].size()) {
+                staged[c].clear();
+                consumed[c] = 0;
+            }
+        }
     }
 
-    for (usize i = 0; i < sizes.Min(); i++) {
-        for (auto& array : data) {
-            outFile << array[i];
-            outFile << ", ";
+    // Binary writes a block as soon as one column fills it, CSV once every column has.
+    void stageDone(usize column) {
+        if (format == ColumnFormat::Binary) {
+            if (stagedCount(column) >= COLUMN_BLOCK_ROWS)
+                flushBlock();
+            return;
         }
-        outFile << "\n";
+
+        for (usize c = 0; c < columns.size(); c++)
+            if (stagedCount(c) < COLUMN_BLOCK_ROWS)
+                return;
+        flushBlock();
+    }
+
+   public:
+    ColumnWriter(std::string         _path,
+                 std::vector<Column> _columns,
+                 ColumnFormat        _format = ColumnFormat::Csv,
+                 bool                append  = false)
+        : path{std::move(_path)},
+          columns{std::move(_columns)},
+          format{_format},
+          staged(columns.size()),
+          consumed(columns.size()) {
+        buffer.reserve(COLUMN_WRITE_BUFFER);
+
+        std::error_code error;
+        if (fs::path(path).has_parent_path())
+            fs::create_directories(fs::path(path).parent_path(), error);
+
+        const std::string expected = header();
+        bool              resume   = false;
+        if (append && fs::exists(path, error) && fs::file_size(path, error) > 0) {
+            std::ifstream existing(path, std::ios::binary);
+            std::string   found(expected.size(), '\0');
+            existing.read(found.data(), found.size());
+            resume = existing.gcount() == (std::streamsize)found.size() && found == expected;
+            if (!resume)
+                std::cout << "WARNING: ENGINE: Columns don't match, overwriting: " << path << "\n";
+        }
+
+        outFile.open(path, std::ios::binary | (resume ? std::ios::app : std::ios::trunc));
+        if (!outFile) {
+            std::cout << "ERROR: ENGINE: Error opening file for writing: " << path << "\n";
+            return;
+        }
+
+        if (!resume)
+            put(expected.data(), expected.size());
+    }
+
+    ColumnWriter(const ColumnWriter&)            = delete;
+    ColumnWriter& operator=(const ColumnWriter&) = delete;
+
+    ~ColumnWriter() { Close(); }
+
+    bool IsOpen() const { return outFile.is_open(); }
+
+    // One value per column, converted to the column's type.
+    template <typename... Ts>
+    void Row(Ts... values) {
+        assert(sizeof...(Ts) == columns.size() && "One value per column");
+        usize column = 0;
+        (stage(column++, values), ...);
+        stageDone(0);
     }
-    outFile.close();
+
+    template <typename T>
+    void Append(usize column, const T* values, usize count) {
+        assert(column < columns.size());
+        for (usize i = 0; i < count;) {
+            const usize room = COLUMN_BLOCK_ROWS - std::min<usize>(stagedCount(column),
+                                                                    COLUMN_BLOCK_ROWS);
+            // A CSV column past a full block waits for the others, so it takes the rest at once.
+            const usize take = room ? std::min(count - i, room) : count - i;
+
+            if (ColumnTypeOf<T>() == columns[column].type) {
+                const u8* from = (const u8*)(values + i);
+                staged[column].insert(staged[column].end(), from, from + take * sizeof(T));
+            } else {
+                for (usize j = i; j < i + take; j++) stage(column, values[j]);
+            }
+
+            i += take;
+            stageDone(column);
+        }
+    }
+
+    template <typename T>
+    void Append(usize column, const Array<T>& values) {
+        Append(column, values.buffer, values.count);
+    }
+
+    // Writes out everything so far, e.g. at the end of a frame. CSV rows that some columns have no
+    // value for yet stay staged until they do, or until Close().
+    void Flush() {
+        if (!IsOpen())
+            return;
+
+        flushBlock();
+        compact();
+        flushBuffer();
+        outFile.flush();
+    }
+
+    void Close() {
+        if (!IsOpen())
+            return;
+
+        flushBlock(true);
+        Flush();
+        outFile.close();
+    }
+};
+
+// Writes arrays side by side as CSV columns, named by the comma separated columns or Value0,
+// Value1... Shorter arrays leave their cells empty past their end.
+template <typename T>
+void SaveAsCsv(const std::string&                    path,
+               std::initializer_list<const Array<T>> data,
+               const char*                           columns = NULL) {
+    std::vector<Column> schema;
+    std::stringstream   names(columns ? columns : "");
+    for (usize i = 0; i < data.size(); i++) {
+        std::string name;
+        if (!std::getline(names, name, ','))
+            name = std::format("Value{}", i);
+        schema.push_back(Column{name, ColumnTypeOf<T>()});
+    }
+
+    ColumnWriter writer(path, std::move(schema));
+    usize        column = 0;
+    for (auto& array : data) writer.Append(column++, array);
 }
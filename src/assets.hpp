@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+#include "profiler.hpp"
+
+// Result of an AssetManager load, empty until it resolves. Copies share the same asset.
+template <typename T>
+class Asset {
+    friend class AssetManager;
+
+    struct State {
+        std::atomic<bool> ready{false};
+        std::optional<T>  value;
+    };
+
+    std::shared_ptr<State> state;
+
+   public:
+    bool IsValid() const { return state != nullptr; }
+    bool IsReady() const { return state && state->ready.load(std::memory_order_acquire); }
+
+    const T& Get() const {
+        assert(IsReady() && "Asset used before it was ready");
+        return *state->value;
+    }
+
+    const T* operator->() const { return &Get(); }
+};
+
+#define DEFAULT_UPLOAD_BUDGET 4.0  // Milliseconds per frame of GPU uploads
+
+// Loads assets without blocking the frame. Disk reads, image decoding and parsing run as jobs on
+// worker threads, into CPU buffers. Anything that needs the GPU is queued as an upload for the
+// render thread, which drains the queue in Update() under a per-frame time budget. Loads return an
+// Asset handle right away that resolves once the last step is done.
+class AssetManager {
+    using Clock = ch::steady_clock;
+
+    std::mutex                        jobsLock;
+    std::condition_variable_any       jobsWaiting;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex                        uploadsLock;
+    std::deque<std::function<void()>> uploads;
+
+    std::atomic<usize>        pending{0};
+    std::vector<std::jthread> workers;  // Last, so they stop before the queues go away
+
+    void work(std::stop_token stop) {
+        Profiler::SetThreadName("Asset loader");
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock{jobsLock};
+                if (!jobsWaiting.wait(lock, stop, [this] { return !jobs.empty(); }))
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            PROFILE_ZONE("Asset job");
+            job();
+        }
+    }
+
+    void schedule(std::function<void()> job) {
+        {
+            std::lock_guard lock{jobsLock};
+            jobs.push_back(std::move(job));
+        }
+        jobsWaiting.notify_one();
+    }
+
+    void queueUpload(std::function<void()> upload) {
+        std::lock_guard lock{uploadsLock};
+        uploads.push_back(std::move(upload));
+    }
+
+   public:
+    explicit AssetManager(u32 threads = 2) {
+        for (u32 i = 0; i < std::max(threads, 1u); i++)
+            workers.emplace_back([this](std::stop_token stop) { work(stop); });
+    }
+
+    AssetManager(const AssetManager&)            = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    // Loads still in flight are dropped.
+    ~AssetManager() {
+        for (auto& worker : workers) worker.request_stop();
+        workers.clear();
+    }
+
+    // CPU only: decode() runs on a worker and the asset is ready as soon as it returns.
+    template <typename T>
+    Asset<T> Load(std::function<T()> decode) {
+        Asset<T> asset;
+        asset.state = std::make_shared<typename Asset<T>::State>();
+        pending++;
+        schedule([this, state = asset.state, decode = std::move(decode)] {
+            state->value = decode();
+            state->ready.store(true, std::memory_order_release);
+            pending--;
+        });
+        return asset;
+    }
+
+    // decode() runs on a worker, then upload() turns its result into the asset on the render
+    // thread, inside Update().
+    template <typename T, typename Decoded>
+    Asset<T> Load(std::function<Decoded()> decode, std::function<T(Decoded&)> upload) {
+        Asset<T> asset;
+        asset.state = std::make_shared<typename Asset<T>::State>();
+        pending++;
+        schedule([this, state = asset.state, decode = std::move(decode), upload] {
+            auto decoded = std::make_shared<Decoded>(decode());
+            queueUpload([this, state, decoded, upload] {
+                state->value = upload(*decoded);
+                state->ready.store(true, std::memory_order_release);
+                pending--;
+            });
+        });
+        return asset;
+    }
+
+    // The texture belongs to the caller once it resolves. Its id is 0 if the image didn't load.
+    Asset<Texture> LoadTexture(const std::string& path) {
+        return Load<Texture, Image>([path] { return LoadImage(path.c_str()); },
+                                    [path](Image& image) {
+                                        Texture texture{};
+                                        if (image.data)
+                                            texture = LoadTextureFromImage(image);
+                                        else
+                                            std::cout << "ERROR: ENGINE: Error loading image: "
+                                                      << path << "\n";
+                                        UnloadImage(image);
+                                        return texture;
+                                    });
+    }
+
+    // Runs queued uploads until the budget is spent, and always at least one.
+    void Update(f64 budgetMilliseconds = DEFAULT_UPLOAD_BUDGET) {
+        const auto start = Clock::now();
+        while (true) {
+            std::function<void()> upload;
+            {
+                std::lock_guard lock{uploadsLock};
+                if (uploads.empty())
+                    return;
+                upload = std::move(uploads.front());
+                uploads.pop_front();
+            }
+            upload();
+
+            if (ch::duration<f64, std::milli>(Clock::now() - start).count() >= budgetMilliseconds)
+                return;
+        }
+    }
+
+    // Loads not yet resolved.
+    usize Pending() const { return pending.load(); }
+};
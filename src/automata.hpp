@@ -0,0 +1,761 @@
+#pragma once
+
+#include <barrier>
+#include <bit>
+#include <deque>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#include "engine.hpp"
+
+enum CellState {
+    Dead,
+    Alive,
+};
+
+enum BoardEdges { Toroidal, Bounded };
+
+// Outer totalistic rule in B/S notation, e.g. "B3/S23" for Conway's Game of Life or "B36/S23"
+// for HighLife. Bit n of birth/survive is set when a cell with n living neighbours is born/
+// survives. Generations rules add a number of states with C, e.g. "B2/S/C3" for Brian's Brain:
+// cells that don't survive go through states 2 to C - 1 before dying, and can't be born meanwhile.
+struct AutomatonRule {
+    u16 birth   = 1 << 3;
+    u16 survive = 1 << 2 | 1 << 3;
+    u8  states  = 2;
+
+    static AutomatonRule Parse(const char* rule) {
+        AutomatonRule result{0, 0, 2};
+        u16*          current = nullptr;
+
+        auto malformed = [rule]() {
+            std::cout << "WARNING: ENGINE: Malformed automaton rule " << rule << ", using B3/S23\n";
+            return AutomatonRule{};
+        };
+
+        for (const char* c = rule; *c; c++) {
+            if (*c == 'B' || *c == 'b')
+                current = &result.birth;
+            else if (*c == 'S' || *c == 's')
+                current = &result.survive;
+            else if ((*c == 'C' || *c == 'c') && c[1] >= '0' && c[1] <= '9') {
+                // Left at 0 if it doesn't fit, which is rejected too.
+                u32 states = 0;
+                c          = std::from_chars(c + 1, c + strlen(c), states).ptr - 1;
+                if (states < 2 || states > 255)
+                    return malformed();
+                result.states = (u8)states;
+                current       = nullptr;
+            } else if (*c >= '0' && *c <= '8' && current)
+                *current |= 1 << (*c - '0');
+            else if (*c != '/')
+                return malformed();
+        }
+
+        return result;
+    }
+};
+
+// Image drawn as a single textured quad, its pixels written directly by the CPU every frame and
+// uploaded with one UpdateTexture(). Created on first use, so boards can be stepped without a
+// window.
+class AutomatonCanvas {
+    Image   image{};
+    Texture texture{};
+
+    void unload() {
+        if (image.data)
+            UnloadImage(image);
+        if (texture.id)
+            UnloadTexture(texture);
+    }
+
+   public:
+    AutomatonCanvas() {}
+    AutomatonCanvas(const AutomatonCanvas&)            = delete;
+    AutomatonCanvas& operator=(const AutomatonCanvas&) = delete;
+    ~AutomatonCanvas() { unload(); }
+
+    // RGBA pixels to write this frame, row by row.
+    Color* Pixels(u32 width, u32 height) {
+        if (!image.data || image.width != (i32)width || image.height != (i32)height) {
+            unload();
+            image   = GenImageColor(width, height, BLANK);
+            texture = LoadTextureFromImage(image);
+        }
+        return (Color*)image.data;
+    }
+
+    void Draw(Rectangle dest) {
+        UpdateTexture(texture, image.data);
+        DrawTexturePro(texture,
+                       Rectangle{0, 0, (f32)image.width, (f32)image.height},
+                       dest,
+                       v2{},
+                       0,
+                       WHITE);
+    }
+};
+
+// Counts the living neighbours of 64 cells at once. Each argument holds one neighbour of every
+// cell in a word; the result is the count as four bit planes (1s, 2s, 4s and 8s).
+struct NeighbourCount {
+    u64 s0, s1, s2, s3;
+
+    NeighbourCount(u64 n0, u64 n1, u64 n2, u64 n3, u64 n4, u64 n5, u64 n6, u64 n7) {
+        // Full adders over the 8 inputs, then over their carries.
+        u64 a0 = n0 ^ n1 ^ n2, c0 = (n0 & n1) | (n2 & (n0 ^ n1));
+        u64 a1 = n3 ^ n4 ^ n5, c1 = (n3 & n4) | (n5 & (n3 ^ n4));
+        u64 a2 = n6 ^ n7, c2 = n6 & n7;
+
+        u64 c3 = (a0 & a1) | (a2 & (a0 ^ a1));
+        s0     = a0 ^ a1 ^ a2;
+
+        u64 t0 = c0 ^ c1 ^ c2, c4 = (c0 & c1) | (c2 & (c0 ^ c1));
+        u64 c5 = t0 & c3;
+        s1     = t0 ^ c3;
+        s2     = c4 ^ c5;
+        s3     = c4 & c5;
+    }
+
+    // Mask of the cells with exactly n neighbours.
+    u64 Equals(u32 n) const {
+        return (n & 1 ? s0 : ~s0) & (n & 2 ? s1 : ~s1) & (n & 4 ? s2 : ~s2) & (n & 8 ? s3 : ~s3);
+    }
+
+    // Mask of the cells whose neighbour count is in the set of counts.
+    u64 In(u16 counts) const {
+        u64 result = 0;
+        for (; counts; counts &= counts - 1) result |= Equals(std::countr_zero(counts));
+        return result;
+    }
+};
+
+// TODO Cellular Automata GDExtension plugin
+// Inherits from tilemap?
+//
+// Two-state automaton of any size, one bit per cell. Cell (x, y) is bit x % 64 of word
+// x / 64 of row y. Every generation is computed 64 cells at a time from the front buffer into the
+// back buffer, then the two are swapped.
+//
+// The board is also split in tiles of 64x64 cells. A tile is only recomputed when it or one of
+// its neighbours changed in the last generation; otherwise both buffers already hold its next
+// state. Rows of tiles can be stepped in parallel bands, see Update(generations, threads).
+struct ConwayBoard {
+    const u32     width, height;
+    const u32     stride;  // Words per row
+    AutomatonRule rule;
+    BoardEdges    edges;
+    u64           generation = 0;
+
+    // Cells in the tiles actually recomputed, all generations so far. Tiles skipped for having no
+    // activity around them don't count.
+    std::atomic<u64> cellsStepped{0};
+
+    ConwayBoard(u32 _width, u32 _height, AutomatonRule _rule = {}, BoardEdges _edges = Toroidal)
+        : width{_width},
+          height{_height},
+          stride{(_width + 63) / 64},
+          rule{_rule},
+          edges{_edges},
+          front(stride * height),
+          back(stride * height),
+          empty(stride),
+          lastMask{width % 64 ? (u64(1) << (width % 64)) - 1 : ~u64(0)},
+          tileRows{(_height + TILE_ROWS - 1) / TILE_ROWS},
+          changed(tileRows * stride, 1),
+          nextChanged(tileRows * stride, 1) {}
+
+    virtual ~ConwayBoard() = default;
+
+    ConwayBoard(Array<v2> initialLiving) : ConwayBoard(64, 64) {
+        for (usize i = 0; i < initialLiving.count; i++)
+            Set((u32)initialLiving[i].x, (u32)initialLiving[i].y, CellState::Alive);
+    }
+
+    CellState Get(u32 x, u32 y) const {
+        assert(x < width && y < height);
+        return CellState((front[y * stride + x / 64] >> (x % 64)) & 1);
+    }
+
+    // Virtual, with Clear(), Update() and Draw(), so boards that keep more per cell stay in step
+    // when used as a ConwayBoard, e.g. by HashLife::Export().
+    virtual void Set(u32 x, u32 y, CellState state) {
+        assert(x < width && y < height);
+        u64& word = front[y * stride + x / 64];
+        word      = (word & ~(u64(1) << (x % 64))) | (u64(state) << (x % 64));
+
+        changed[y / TILE_ROWS * stride + x / 64] = 1;
+    }
+
+    virtual void Clear() {
+        std::fill(front.begin(), front.end(), 0);
+        std::fill(changed.begin(), changed.end(), 1);
+    }
+
+    void Randomize(f32 density = 0.5f, u64 seed = 0) {
+        std::mt19937_64             eng(seed);
+        std::bernoulli_distribution distr(density);
+
+        Clear();
+        for (u32 y = 0; y < height; y++)
+            for (u32 x = 0; x < width; x++)
+                if (distr(eng))
+                    Set(x, y, CellState::Alive);
+    }
+
+    u64 Population() const {
+        u64 result = 0;
+        for (u64 word : front) result += std::popcount(word);
+        return result;
+    }
+
+    // Computes the next generation.
+    virtual void Update() {
+        stepBand(0, tileRows);
+        swap();
+    }
+
+    // Computes the next generations, splitting the board in one band of tile rows per thread.
+    // Bands read the rows around them (their halo) straight from the shared front buffer, which
+    // stays read-only until every band is done with the generation.
+    virtual void Update(u32 generations, u32 threads) {
+        threads = std::clamp(threads, 1u, tileRows);
+
+        auto         swapBuffers = [this]() noexcept { swap(); };
+        std::barrier sync(threads, swapBuffers);
+
+        auto work = [&](u32 band) {
+            u32 begin = tileRows * band / threads;
+            u32 end   = tileRows * (band + 1) / threads;
+            for (u32 i = 0; i < generations; i++) {
+                stepBand(begin, end);
+                sync.arrive_and_wait();
+            }
+        };
+
+        std::vector<std::jthread> workers;
+        for (u32 i = 1; i < threads; i++) workers.emplace_back(work, i);
+        work(0);
+    }
+
+    virtual void Draw(Rectangle dest, Color living = BLACK, Color dead = BLANK) {
+        Color* pixels = canvas.Pixels(width, height);
+        for (u32 y = 0; y < height; y++)
+            for (u32 w = 0; w < stride; w++) {
+                u64    word = front[y * stride + w];
+                Color* out  = &pixels[y * width + w * 64];
+                for (u32 i = 0; i < std::min(64u, width - w * 64); i++)
+                    out[i] = (word >> i) & 1 ? living : dead;
+            }
+        canvas.Draw(dest);
+    }
+
+    void Draw() { Draw(Rectangle{0, 0, (f32)width, (f32)height}); }
+
+   protected:
+    std::vector<u64> front, back;
+    std::vector<u64> empty;  // Row beyond a bounded edge
+    const u64        lastMask;
+    AutomatonCanvas  canvas;
+
+    const u64* row(i64 y) const {
+        if (y < 0 || y >= height) {
+            if (edges == Bounded)
+                return empty.data();
+            y = (y + height) % height;
+        }
+        return &front[y * stride];
+    }
+
+    // Neighbours of the cells in word w of a row, one to the west (x - 1) and one to the east
+    // (x + 1) of every cell.
+    u64 west(const u64* row, u32 w) const {
+        u64 carry = w > 0                ? row[w - 1] >> 63
+                    : edges == Toroidal ? (row[stride - 1] >> ((width - 1) % 64)) & 1
+                                        : 0;
+        return (row[w] << 1) | carry;
+    }
+
+    u64 east(const u64* row, u32 w) const {
+        u64 carry = w + 1 < stride       ? row[w + 1] << 63
+                    : edges == Toroidal ? (row[0] & 1) << ((width - 1) % 64)
+                                        : 0;
+        return (row[w] >> 1) | carry;
+    }
+
+    static constexpr u32 TILE_ROWS = 64;
+
+    // Per tile (one word wide, TILE_ROWS tall): whether the front and back buffers may differ.
+    const u32       tileRows;
+    std::vector<u8> changed, nextChanged;
+
+    void swap() noexcept {
+        std::swap(front, back);
+        std::swap(changed, nextChanged);
+        generation++;
+    }
+
+    bool isActive(u32 ty, u32 tw) const {
+        for (i64 dy = -1; dy <= 1; dy++) {
+            i64 y = (i64)ty + dy;
+            if (y < 0 || y >= tileRows) {
+                if (edges == Bounded)
+                    continue;
+                y = (y + tileRows) % tileRows;
+            }
+
+            for (i64 dx = -1; dx <= 1; dx++) {
+                i64 x = (i64)tw + dx;
+                if (x < 0 || x >= stride) {
+                    if (edges == Bounded)
+                        continue;
+                    x = (x + stride) % stride;
+                }
+
+                if (changed[y * stride + x])
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Living neighbours of the cells in word w of row y.
+    NeighbourCount count(u32 y, u32 w) const {
+        const u64* above  = row((i64)y - 1);
+        const u64* center = row(y);
+        const u64* below  = row((i64)y + 1);
+
+        return NeighbourCount(west(above, w),
+                              above[w],
+                              east(above, w),
+                              west(center, w),
+                              east(center, w),
+                              west(below, w),
+                              below[w],
+                              east(below, w));
+    }
+
+    // Writes one tile of the next generation into the back buffer.
+    void stepTile(u32 ty, u32 w) {
+        u64 difference = 0;
+
+        for (u32 y = ty * TILE_ROWS; y < std::min((ty + 1) * TILE_ROWS, height); y++) {
+            NeighbourCount neighbours = count(y, w);
+            u64            center     = front[y * stride + w];
+
+            u64 next = (~center & neighbours.In(rule.birth)) |
+                       (center & neighbours.In(rule.survive));
+            if (w == stride - 1)
+                next &= lastMask;
+
+            back[y * stride + w] = next;
+            difference |= next ^ center;
+        }
+
+        nextChanged[ty * stride + w] = difference != 0;
+    }
+
+    // Steps the tile rows [begin, end), skipping tiles with no activity around them.
+    void stepBand(u32 begin, u32 end) {
+        u64 stepped = 0;
+        for (u32 ty = begin; ty < end; ty++)
+            for (u32 w = 0; w < stride; w++) {
+                if (isActive(ty, w)) {
+                    stepTile(ty, w);
+                    stepped += std::min(TILE_ROWS, height - ty * TILE_ROWS) *
+                               std::min(64u, width - w * 64);
+                } else {
+                    nextChanged[ty * stride + w] = 0;
+                }
+            }
+        cellsStepped.fetch_add(stepped, std::memory_order_relaxed);
+    }
+};
+
+// Generations automaton (see AutomatonRule) with any number of states, one byte per cell, and a
+// one byte history ring per cell: bit i is set if the cell was alive i generations ago. Neighbours
+// are still counted 64 at a time on the bit plane of living cells inherited from ConwayBoard;
+// only words with living, dying or recently alive cells touch the per-cell bytes.
+struct GenerationsBoard : public ConwayBoard {
+    // Colors of living and dying cells by state, and of the trail left by dead cells.
+    std::vector<Color> palette;
+    Color              trail = Color{0, 121, 241, 96};
+
+    GenerationsBoard(u32           _width,
+                     u32           _height,
+                     AutomatonRule _rule  = AutomatonRule::Parse("B2/S/C3"),
+                     BoardEdges    _edges = Toroidal)
+        : ConwayBoard(_width, _height, _rule, _edges),
+          palette(_rule.states),
+          states(_width * _height),
+          history(_width * _height),
+          dying(stride * height),
+          recent(stride * height) {
+        palette[1] = BLACK;
+        for (u32 i = 2; i < rule.states; i++) {
+            f32 t      = f32(i - 2) / std::max(1, rule.states - 3);
+            palette[i] = Color{u8(80 + 150 * t), u8(80 + 150 * t), 255, u8(255 - 128 * t)};
+        }
+    }
+
+    u8 GetState(u32 x, u32 y) const { return states[y * width + x]; }
+
+    u8 GetHistory(u32 x, u32 y) const { return history[y * width + x]; }
+
+    void SetState(u32 x, u32 y, u8 state) {
+        assert(state < rule.states);
+        ConwayBoard::Set(x, y, state == 1 ? CellState::Alive : CellState::Dead);
+        states[y * width + x] = state;
+
+        u64 bit = u64(1) << (x % 64);
+        u64& d  = dying[y * stride + x / 64];
+        d       = state >= 2 ? d | bit : d & ~bit;
+        recent[y * stride + x / 64] |= bit;
+    }
+
+    void Set(u32 x, u32 y, CellState state) override { SetState(x, y, (u8)state); }
+
+    void Clear() override {
+        ConwayBoard::Clear();
+        std::fill(states.begin(), states.end(), 0);
+        std::fill(history.begin(), history.end(), 0);
+        std::fill(dying.begin(), dying.end(), 0);
+        std::fill(recent.begin(), recent.end(), 0);
+    }
+
+    void Update() override {
+        for (u32 y = 0; y < height; y++)
+            for (u32 w = 0; w < stride; w++) {
+                const usize word   = y * stride + w;
+                const u64   living = front[word];
+
+                NeighbourCount neighbours = count(y, w);
+
+                u64 born = ~living & ~dying[word] & neighbours.In(rule.birth);
+                u64 stay = living & neighbours.In(rule.survive);
+                if (w == stride - 1)
+                    born &= lastMask;
+
+                back[word] = born | stay;
+
+                u64 touched = living | dying[word] | born | recent[word];
+                if (!touched)
+                    continue;
+
+                u64 nextDying = 0, nextRecent = 0;
+                for (u64 m = touched; m; m &= m - 1) {
+                    const u32   i   = std::countr_zero(m);
+                    const usize idx = y * width + w * 64 + i;
+                    u8&         s   = states[idx];
+
+                    if (s == 0)
+                        s = (born >> i) & 1;
+                    else if (s == 1)
+                        s = (stay >> i) & 1 ? 1 : 2 % rule.states;
+                    else
+                        s = (s + 1) % rule.states;
+
+                    history[idx] = u8(history[idx] << 1) | (s == 1);
+
+                    nextDying |= u64(s >= 2) << i;
+                    nextRecent |= u64(history[idx] != 0 || s != 0) << i;
+                }
+                dying[word]  = nextDying;
+                recent[word] = nextRecent;
+            }
+
+        swap();
+    }
+
+    // Generations don't support parallel stepping yet: one generation after another, here.
+    void Update(u32 generations, u32) override {
+        for (u32 i = 0; i < generations; i++) Update();
+    }
+
+    // Colored by the palette rather than living and dead.
+    void Draw(Rectangle dest, Color = BLACK, Color = BLANK) override {
+        Color* pixels = canvas.Pixels(width, height);
+
+        Color trails[8];
+        for (u32 i = 0; i < 8; i++) trails[i] = Fade(trail, f32(trail.a) / 255 * (8 - i) / 8);
+
+        for (usize i = 0; i < states.size(); i++) {
+            u8 s      = states[i];
+            pixels[i] = s ? palette[s] : history[i] ? trails[std::countr_zero(history[i])] : BLANK;
+        }
+        canvas.Draw(dest);
+    }
+
+    using ConwayBoard::Draw;
+
+   protected:
+    std::vector<u8>  states, history;
+    std::vector<u64> dying;   // Bit plane of cells in states 2 and up
+    std::vector<u64> recent;  // Bit plane of cells with a state or history to update
+};
+
+// HashLife: the plane as a quadtree where identical subtrees are stored once, and the future of
+// each node is memoized. Sparse or periodic patterns then advance 2^k generations in time closer
+// to their number of distinct subpatterns than to their area. Works with any AutomatonRule that
+// keeps empty space empty (no B0).
+//
+// The plane is unbounded, unlike ConwayBoard, so patterns are not wrapped or clipped while
+// stepping; Export() only writes back the cells that land inside the board.
+class HashLife {
+    struct Node {
+        const Node *nw, *ne, *sw, *se;  // nullptr for single cells
+        u32         level;              // Side is 2^level cells
+        u64         population;
+
+        // Memoized center, advanced by 2^resultStep generations.
+        mutable const Node* result     = nullptr;
+        mutable u32         resultStep = 0;
+    };
+
+    struct Key {
+        const Node *nw, *ne, *sw, *se;
+        bool        operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        usize operator()(const Key& key) const {
+            u64 h = (u64)key.nw;
+            h     = h * 0x9E3779B97F4A7C15 ^ (u64)key.ne;
+            h     = h * 0x9E3779B97F4A7C15 ^ (u64)key.sw;
+            h     = h * 0x9E3779B97F4A7C15 ^ (u64)key.se;
+            return h ^ (h >> 29);
+        }
+    };
+
+    AutomatonRule rule;
+
+    std::deque<Node>                               nodes;
+    std::unordered_map<Key, const Node*, KeyHash> table;
+    std::vector<const Node*>                       empties;  // Empty node per level
+    const Node *                                   dead, *alive;
+
+    const Node* root;
+    i64         originX = 0, originY = 0;  // Plane coordinates of the root's top-left cell
+
+    const Node* join(const Node* nw, const Node* ne, const Node* sw, const Node* se) {
+        auto [it, inserted] = table.try_emplace(Key{nw, ne, sw, se});
+        if (inserted) {
+            u64 population = nw->population + ne->population + sw->population + se->population;
+            it->second     = &nodes.emplace_back(Node{nw, ne, sw, se, nw->level + 1, population});
+        }
+        return it->second;
+    }
+
+    const Node* empty(u32 level) {
+        while (empties.size() <= level) {
+            const Node* e = empties.back();
+            empties.push_back(join(e, e, e, e));
+        }
+        return empties[level];
+    }
+
+    void reset() {
+        nodes.clear();
+        table.clear();
+        empties.clear();
+
+        dead  = &nodes.emplace_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 0});
+        alive = &nodes.emplace_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 1});
+        empties.push_back(dead);
+    }
+
+    // Level - 1 node at the middle of a node.
+    const Node* center(const Node* n) { return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw); }
+
+    // One level up, twice the size, with the current root in the middle and empty space around it.
+    void expand() {
+        const Node* e = empty(root->level - 1);
+
+        i64 shift = i64(1) << (root->level - 1);
+        root      = join(join(e, e, e, root->nw),
+                    join(e, e, root->ne, e),
+                    join(e, root->sw, e, e),
+                    join(root->se, e, e, e));
+        originX -= shift;
+        originY -= shift;
+    }
+
+    // 4x4 node: its 2x2 center one generation later, brute force.
+    const Node* base(const Node* n) {
+        u32 cells = 0;  // Bit y * 4 + x
+        for (u32 q = 0; q < 4; q++) {
+            const Node* quadrant = q == 0 ? n->nw : q == 1 ? n->ne : q == 2 ? n->sw : n->se;
+            u32         qx = (q % 2) * 2, qy = (q / 2) * 2;
+
+            cells |= quadrant->nw->population << ((qy + 0) * 4 + qx + 0);
+            cells |= quadrant->ne->population << ((qy + 0) * 4 + qx + 1);
+            cells |= quadrant->sw->population << ((qy + 1) * 4 + qx + 0);
+            cells |= quadrant->se->population << ((qy + 1) * 4 + qx + 1);
+        }
+
+        const Node* next[4];
+        for (u32 y = 1; y < 3; y++)
+            for (u32 x = 1; x < 3; x++) {
+                u32 neighbours = 0;
+                for (u32 dy = y - 1; dy <= y + 1; dy++)
+                    for (u32 dx = x - 1; dx <= x + 1; dx++)
+                        if (dx != x || dy != y)
+                            neighbours += (cells >> (dy * 4 + dx)) & 1;
+
+                bool living = (cells >> (y * 4 + x)) & 1;
+                u16  counts = living ? rule.survive : rule.birth;
+
+                next[(y - 1) * 2 + (x - 1)] = (counts >> neighbours) & 1 ? alive : dead;
+            }
+
+        return join(next[0], next[1], next[2], next[3]);
+    }
+
+    // Center of a node of level L, advanced by 2^step generations, step <= L - 2.
+    const Node* successor(const Node* n, u32 step) {
+        if (n->population == 0)
+            return empty(n->level - 1);
+        if (n->result && n->resultStep == step)
+            return n->result;
+        if (n->level == 2) {
+            n->result     = base(n);
+            n->resultStep = step;
+            return n->result;
+        }
+
+        // The 9 overlapping level L - 1 nodes covering the middle of n.
+        const Node* m[9] = {n->nw,
+                            join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw),
+                            n->ne,
+                            join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne),
+                            center(n),
+                            join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne),
+                            n->sw,
+                            join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw),
+                            n->se};
+
+        // At full speed both halves of the jump advance, otherwise only the second one does.
+        const bool full = step == n->level - 2;
+        const u32  half = full ? step - 1 : step;
+
+        const Node* r[9];
+        for (u32 i = 0; i < 9; i++) r[i] = full ? successor(m[i], half) : center(m[i]);
+
+        const Node* result = join(successor(join(r[0], r[1], r[3], r[4]), half),
+                                  successor(join(r[1], r[2], r[4], r[5]), half),
+                                  successor(join(r[3], r[4], r[6], r[7]), half),
+                                  successor(join(r[4], r[5], r[7], r[8]), half));
+
+        n->result     = result;
+        n->resultStep = step;
+        return result;
+    }
+
+    // Quadtree of the board region at (x, y) with side 2^level.
+    const Node* build(const ConwayBoard& board, u32 x, u32 y, u32 level) {
+        if (x >= board.width || y >= board.height)
+            return empty(level);
+        if (level == 0)
+            return board.Get(x, y) == CellState::Alive ? alive : dead;
+
+        u32 half = 1 << (level - 1);
+        return join(build(board, x, y, level - 1),
+                    build(board, x + half, y, level - 1),
+                    build(board, x, y + half, level - 1),
+                    build(board, x + half, y + half, level - 1));
+    }
+
+    void write(const Node* n, ConwayBoard& board, i64 x, i64 y) const {
+        i64 side = i64(1) << n->level;
+        if (n->population == 0 || x >= board.width || y >= board.height || x + side <= 0 ||
+            y + side <= 0)
+            return;
+
+        if (n->level == 0) {
+            board.Set((u32)x, (u32)y, CellState::Alive);
+            return;
+        }
+
+        write(n->nw, board, x, y);
+        write(n->ne, board, x + side / 2, y);
+        write(n->sw, board, x, y + side / 2);
+        write(n->se, board, x + side / 2, y + side / 2);
+    }
+
+    // Rebuilds the table with only the nodes reachable from the root, dropping memoized results.
+    void collect() {
+        std::unordered_map<const Node*, const Node*> moved;
+        std::deque<Node>                              oldNodes;
+        std::swap(nodes, oldNodes);
+        reset();
+
+        std::function<const Node*(const Node*)> copy = [&](const Node* n) -> const Node* {
+            if (n->level == 0)
+                return n->population ? alive : dead;
+
+            auto it = moved.find(n);
+            if (it != moved.end())
+                return it->second;
+
+            const Node* result = join(copy(n->nw), copy(n->ne), copy(n->sw), copy(n->se));
+            moved[n]           = result;
+            return result;
+        };
+
+        root = copy(root);
+    }
+
+   public:
+    u64   generation = 0;
+    usize maxNodes   = 1 << 22;  // Garbage collected past this
+
+    explicit HashLife(AutomatonRule _rule = {}) : rule{_rule} {
+        assert(!(rule.birth & 1) && "HashLife needs empty space to stay empty");
+        reset();
+        root = empty(3);
+    }
+
+    u64 Population() const { return root->population; }
+
+    usize NodeCount() const { return table.size(); }
+
+    // Replaces the plane with the board, its top-left cell at (0, 0).
+    void Import(const ConwayBoard& board) {
+        reset();
+
+        u32 level = 3;
+        while ((1u << level) < std::max(board.width, board.height)) level++;
+
+        root       = build(board, 0, 0, level);
+        originX    = 0;
+        originY    = 0;
+        generation = board.generation;
+    }
+
+    // Clears the board and writes the cells of the plane that fall inside it.
+    void Export(ConwayBoard& board) const {
+        board.Clear();
+        write(root, board, originX, originY);
+        board.generation = generation;
+    }
+
+    // Advances 2^log2Generations generations at once.
+    void Step(u32 log2Generations) {
+        if (table.size() > maxNodes)
+            collect();
+
+        // Big enough for the jump, and with the whole pattern in the middle quarter so nothing
+        // can reach the border before the jump is over.
+        while (root->level < log2Generations + 2 || center(root)->population != root->population)
+            expand();
+        expand();
+
+        i64 shift = i64(1) << (root->level - 2);
+        root      = successor(root, log2Generations);
+        originX += shift;
+        originY += shift;
+        generation += u64(1) << log2Generations;
+    }
+};
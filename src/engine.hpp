@@ -3,13 +3,30 @@
 #include <raylib.h>
 #define RAYGUI_IMPLEMENTATION
 #include <raygui.h>
+#include <rlgl.h>
 
 #include "algorithm.hpp"
 
+// Shaders are loaded from shaders/glsl<GLSL_VERSION>/.
+#if defined(PLATFORM_DESKTOP)
+#define GLSL_VERSION 330
+#else  // PLATFORM_ANDROID, PLATFORM_WEB
+#define GLSL_VERSION 100
+#endif
+
 struct BaseCamera2D : public Camera2D {
+    BaseCamera2D() : Camera2D{v2{}, v2{}, 0, 1} {}
+
     v2 Reproject(const v2& vector) { return (vector + target - offset) / zoom; }
 
+    // Gathers input once per rendered frame, for the ticks that follow.
+    virtual void Input() {};
+
+    // Advances the camera by one simulation tick.
     virtual void Update() {};
+
+    // The camera to render with, alpha of the way from the tick before the last to the last one.
+    virtual Camera2D Interpolated(f32 /* alpha */) const { return *this; }
 };
 
 struct PixelCamera2D : public BaseCamera2D {
@@ -28,7 +45,31 @@ struct SmoothCamera2D : public BaseCamera2D {
     f32 rotationClamp[2] = {-40, 40};
     f32 zoomClamp[2]     = {0.001f, 30.0f};
 
+    Camera2D previous{};  // As of the tick before the last
+
+    // Input since the last tick. A frame can run any number of ticks, including none.
+    f32  wheel      = 0;
+    v2   drag       = {};
+    bool reset      = false;
+    f32  buttonHeld = 0;
+
+    void Input() final {
+        wheel += GetMouseWheelMove();
+
+        if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+            buttonHeld += GetFrameTime();
+            if (buttonHeld >= 0.200f)
+                drag = drag + GetMouseDelta();
+        }
+
+        if (IsMouseButtonReleased(MOUSE_BUTTON_MIDDLE)) {
+            reset      = reset || buttonHeld < 0.200f;
+            buttonHeld = 0;
+        }
+    }
+
     void Update() final {
+        previous = *this;
         rotation = dampedRotation.Set();
 
         MiddleMouseMovementAndZoom();
@@ -36,6 +77,15 @@ struct SmoothCamera2D : public BaseCamera2D {
         Clamp();
     }
 
+    Camera2D Interpolated(f32 alpha) const final {
+        Camera2D camera = *this;
+        camera.offset   = previous.offset + alpha * (v2(offset) - previous.offset);
+        camera.target   = previous.target + alpha * (v2(target) - previous.target);
+        camera.rotation = previous.rotation + alpha * (rotation - previous.rotation);
+        camera.zoom     = previous.zoom + alpha * (zoom - previous.zoom);
+        return camera;
+    }
+
     void Clamp() {
         if (rotation > rotationClamp[1])
             rotation = rotationClamp[1];
@@ -59,26 +109,18 @@ struct SmoothCamera2D : public BaseCamera2D {
     }
 
     void MiddleMouseMovementAndZoom() {
-        zoom = dampedZoom.By((float)GetMouseWheelMove() * 0.15f);
+        zoom = dampedZoom.By(wheel * 0.15f);
 
-        static f32 buttonHeld{};
-        if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
-            buttonHeld += GetFrameTime();
-        }
-
-        if (IsMouseButtonReleased(MOUSE_BUTTON_MIDDLE) && buttonHeld < 0.200f) {
-            zoom       = dampedZoom.Set(1.0f);
-            rotation   = dampedRotation.Set(0.0f);
-            buttonHeld = 0;
+        if (reset) {
+            zoom     = dampedZoom.Set(1.0f);
+            rotation = dampedRotation.Set(0.0f);
         }
 
-        if (IsMouseButtonReleased(MOUSE_BUTTON_MIDDLE)) {
-            buttonHeld = 0;
-        }
+        offset = dampedOffset.By(drag);
 
-        offset = dampedOffset.By(IsMouseButtonDown(MOUSE_BUTTON_MIDDLE) && buttonHeld >= 0.200f
-                                     ? GetMouseDelta()
-                                     : v2{});
+        wheel = 0;
+        drag  = {};
+        reset = false;
     }
 };
 
@@ -139,27 +181,388 @@ struct ItemGrabber {
     }
 };
 
+// Retained debug drawing. Points, lines, circles and labels are queued into vertex arrays during
+// the frame and Flush() sends each kind to rlgl in as few batches as fit, rather than making one
+// raylib call (and for circles, one triangle fan) per shape. Labels that would land on top of an
+// earlier one at the current zoom are skipped.
+class DebugDraw {
+    struct Vertex {
+        v2    position;
+        Color color;
+    };
+
+    struct Label {
+        v2    position;
+        i32   size;
+        Color color;
+        usize text;  // Offset into labelText, null terminated
+    };
+
+    std::vector<Vertex> triangles;  // Filled circles
+    std::vector<Vertex> lines;      // Lines and circle outlines
+    std::vector<Label>  labels;
+    std::string         labelText;
+    std::vector<v2>     unitCircle;  // For pointSegments
+
+    std::unordered_set<u64> occupied;  // Label cells taken this frame
+
+    // Vertices go out in runs that fit the rlgl batch, which flushes itself when it's full.
+    static void emit(const std::vector<Vertex>& vertices, i32 mode, usize group) {
+        const usize run = 4096 - 4096 % group;
+        for (usize from = 0; from < vertices.size(); from += run) {
+            const usize to = std::min(vertices.size(), from + run);
+            rlCheckRenderBatchLimit((i32)(to - from));
+
+            rlBegin(mode);
+            for (usize i = from; i < to; i++) {
+                const Vertex& vertex = vertices[i];
+                rlColor4ub(vertex.color.r, vertex.color.g, vertex.color.b, vertex.color.a);
+                rlVertex2f(vertex.position.x, vertex.position.y);
+            }
+            rlEnd();
+        }
+    }
+
+   public:
+    u32 pointSegments = 12;
+    f32 labelSpacing  = 24;  // Screen pixels kept between labels
+
+    void Point(v2 center, f32 radius, Color color) {
+        if (unitCircle.size() != pointSegments + 1) {
+            unitCircle.resize(pointSegments + 1);
+            for (u32 i = 0; i <= pointSegments; i++) {
+                f32 angle     = 2 * PI * i / pointSegments;
+                unitCircle[i] = v2{cosf(angle), sinf(angle)};
+            }
+        }
+
+        // Counter-clockwise on screen, y pointing down.
+        for (u32 i = 0; i < pointSegments; i++) {
+            triangles.push_back({center, color});
+            triangles.push_back({center + radius * unitCircle[i + 1], color});
+            triangles.push_back({center + radius * unitCircle[i], color});
+        }
+    }
+
+    void Line(v2 from, v2 to, Color color) {
+        lines.push_back({from, color});
+        lines.push_back({to, color});
+    }
+
+    void CircleOutline(v2 center, f32 radius, Color color) {
+        const u32 segments = std::clamp((u32)(radius / 2), 16u, 128u);
+        v2        previous = center + v2{radius, 0};
+        for (u32 i = 1; i <= segments; i++) {
+            f32 angle = 2 * PI * i / segments;
+            v2  next  = center + radius * v2{cosf(angle), sinf(angle)};
+            Line(previous, next, color);
+            previous = next;
+        }
+    }
+
+    template <typename... Args>
+    void Text(v2                          position,
+              i32                         size,
+              Color                       color,
+              std::format_string<Args...> format,
+              Args&&... args) {
+        labels.push_back(Label{position, size, color, labelText.size()});
+        std::format_to(std::back_inserter(labelText), format, std::forward<Args>(args)...);
+        labelText.push_back('\0');
+    }
+
+    // Draws and clears everything queued. zoom scales queued positions to screen pixels, for
+    // telling which labels overlap.
+    void Flush(f32 zoom = 1) {
+        emit(triangles, RL_TRIANGLES, 3);
+        emit(lines, RL_LINES, 2);
+
+        const f32 cell = labelSpacing / zoom;
+        for (const Label& label : labels) {
+            u64 key = (u64)(u32)(i32)floorf(label.position.x / cell) << 32 |
+                      (u32)(i32)floorf(label.position.y / cell);
+            if (!occupied.insert(key).second)
+                continue;
+
+            DrawText(&labelText[label.text],
+                     label.position.x,
+                     label.position.y,
+                     label.size,
+                     label.color);
+        }
+
+        triangles.clear();
+        lines.clear();
+        labels.clear();
+        labelText.clear();
+        occupied.clear();
+    }
+};
+
+#define SIMULATION_RATE 60    // Ticks per second
+#define MAX_CATCH_UP_TICKS 5  // Per frame, before the simulation drops time
+
+// Runs a simulation at a fixed rate under a variable frame rate. Frame time is banked and spent
+// in whole ticks, so the simulation behaves the same at any frame rate. After a stall at most
+// maxTicks run in one frame and the rest of the debt is dropped, rather than spiralling into ever
+// longer frames. Alpha() is how far the frame falls between the last two ticks, to interpolate
+// what's drawn by.
+class FixedTimestep {
+    f64 accumulator = 0;
+
+   public:
+    f32 delta;
+    u32 maxTicks;
+
+    explicit FixedTimestep(f32 rate = SIMULATION_RATE, u32 _maxTicks = MAX_CATCH_UP_TICKS)
+        : delta{1 / rate}, maxTicks{_maxTicks} {}
+
+    // Banks frameTime and takes the whole ticks due out of it, at most maxTicks.
+    u32 Consume(f32 frameTime) {
+        accumulator += frameTime;
+
+        u32 ticks = std::min((u32)(accumulator / delta), maxTicks);
+        accumulator -= ticks * (f64)delta;
+        if (accumulator >= delta)
+            accumulator = std::fmod(accumulator, (f64)delta);
+        return ticks;
+    }
+
+    // Calls tick() the given number of times, with the SimulationClock of the calling thread set
+    // to the tick length.
+    template <typename Tick>
+    void Run(u32 ticks, Tick&& tick) const {
+        SimulationClock::tick = delta;
+        for (u32 i = 0; i < ticks; i++) tick();
+        SimulationClock::tick = 0;
+    }
+
+    // Runs tick() once per whole tick in frameTime and the time left over. Returns how many ran.
+    template <typename Tick>
+    u32 Advance(f32 frameTime, Tick&& tick) {
+        u32 ticks = Consume(frameTime);
+        Run(ticks, tick);
+        return ticks;
+    }
+
+    f32 Alpha() const { return (f32)(accumulator / delta); }
+};
+
+// Runs one job at a time on a thread of its own, for work that overlaps the main thread's and is
+// waited on once per frame.
+class FrameWorker {
+    std::mutex                  lock;
+    std::condition_variable_any changed;
+    std::function<void()>       job;
+    bool                        busy = false;
+    std::jthread                thread;  // Last, so it stops before the rest goes away
+
+    void work(std::stop_token stop) {
+        std::unique_lock guard{lock};
+        while (changed.wait(guard, stop, [this] { return busy; })) {
+            guard.unlock();
+            job();
+            guard.lock();
+
+            busy = false;
+            changed.notify_all();
+        }
+    }
+
+   public:
+    FrameWorker() : thread{[this](std::stop_token stop) { work(stop); }} {}
+
+    FrameWorker(const FrameWorker&)            = delete;
+    FrameWorker& operator=(const FrameWorker&) = delete;
+
+    ~FrameWorker() { Wait(); }
+
+    // Waits for the job before, then starts this one.
+    void Start(std::function<void()> _job) {
+        std::unique_lock guard{lock};
+        changed.wait(guard, [this] { return !busy; });
+        job  = std::move(_job);
+        busy = true;
+        changed.notify_all();
+    }
+
+    void Wait() {
+        std::unique_lock guard{lock};
+        changed.wait(guard, [this] { return !busy; });
+    }
+};
+
+// Scenes are driven by the main loop: Input() and the draw calls once per rendered frame, and
+// Compute() once per fixed simulation tick, any number of times per frame.
+//
+// Pipelined scenes run the ticks of frame N+1 on a worker thread while the main thread draws
+// frame N. Compute() then mustn't use raylib or the GPU, and must write what the draw calls read
+// into a back buffer rather than in place. Publish() swaps it to the front, between frames, with
+// the worker idle; the draw calls only read the front buffer. Input() runs with the worker idle
+// too, so it's where changes from the UI reach the simulation.
 struct Scene {
     Scene() {}
     BaseCamera2D camera{};
+    bool         pipelined = false;
+
+    // Makes the last ticks' results the ones drawn. Only called for pipelined scenes.
+    virtual void Publish() {}
 
+    // Gathers input for the ticks that follow. Anything that reads per-frame input, such as
+    // IsKeyPressed() or the mouse wheel, belongs here rather than in Compute().
+    virtual void Input() {}
+
+    // Advances the simulation by SimulationClock::Delta() seconds.
     virtual void Compute() {}
 
     virtual void Draw2D() {}
 
     virtual void DrawUI() {}
+
+    // Called when another scene takes over, before it's first drawn.
+    virtual void Exit() {}
 };
 
+#define TEXTMODE_SHADER_PATH "../shaders/glsl%i/textmode.frag"  // By GLSL_VERSION
+
+// Text-mode console. Each cell has a glyph from the charsheet and a foreground and background
+// colour, kept in separate buffers and mirrored into three data textures with one texel per cell.
+// Draw() uploads only the rows written since the last one, then draws the whole grid as a single
+// quad through the textmode.frag shader, which looks the glyphs up in the charsheet.
 struct CharGrid {
-    const u32 width, height;
-    Texture   charSheet;
-    u8        charResolution;
-    u8*       chars;
+    const u32          width, height;
+    Texture            charSheet{};
+    u8                 charResolution = 8;  // Pixels per glyph side in the charsheet
+    std::vector<u16>   glyphs;
+    std::vector<Color> foreground, background;
+
+   private:
+    std::vector<u8>    dirtyRows;
+    std::vector<Color> packed;  // Glyph indices as texels, low byte in red, high byte in green
+    Texture            glyphTexture{}, foregroundTexture{}, backgroundTexture{};
+    Shader             shader{};
+    i32                foregroundLoc, backgroundLoc, charSheetLoc, gridSizeLoc, sheetSizeLoc;
+
+    void load() {
+        Image blank       = GenImageColor(width, height, BLANK);
+        glyphTexture      = LoadTextureFromImage(blank);
+        foregroundTexture = LoadTextureFromImage(blank);
+        backgroundTexture = LoadTextureFromImage(blank);
+        UnloadImage(blank);
+
+        shader        = LoadShader(0, TextFormat(TEXTMODE_SHADER_PATH, GLSL_VERSION));
+        foregroundLoc = GetShaderLocation(shader, "fgColors");
+        backgroundLoc = GetShaderLocation(shader, "bgColors");
+        charSheetLoc  = GetShaderLocation(shader, "charSheet");
+        gridSizeLoc   = GetShaderLocation(shader, "gridSize");
+        sheetSizeLoc  = GetShaderLocation(shader, "sheetSize");
+
+        std::fill(dirtyRows.begin(), dirtyRows.end(), 1);
+    }
+
+    // Each run of dirty rows goes up in one UpdateTextureRec() per texture.
+    void upload() {
+        for (u32 from = 0; from < height;) {
+            if (!dirtyRows[from]) {
+                from++;
+                continue;
+            }
+
+            u32 to = from;
+            while (to < height && dirtyRows[to]) dirtyRows[to++] = 0;
+
+            const usize     first = (usize)from * width, count = (usize)(to - from) * width;
+            const Rectangle rows{0, (f32)from, (f32)width, (f32)(to - from)};
+            for (usize i = first; i < first + count; i++)
+                packed[i] = Color{u8(glyphs[i] & 0xFF), u8(glyphs[i] >> 8), 0, 255};
+
+            UpdateTextureRec(glyphTexture, rows, &packed[first]);
+            UpdateTextureRec(foregroundTexture, rows, &foreground[first]);
+            UpdateTextureRec(backgroundTexture, rows, &background[first]);
+            from = to;
+        }
+    }
 
+   public:
     CharGrid(u32 _width, u32 _height)
-        : width{_width}, height{_height}, chars{(u8*)malloc(width * height)} {}
+        : width{_width},
+          height{_height},
+          glyphs(width * height, 0),
+          foreground(width * height, WHITE),
+          background(width * height, BLACK),
+          dirtyRows(height, 1),
+          packed(width * height) {}
+
+    CharGrid(u32 _width) : CharGrid(_width, _width) {}
+
+    CharGrid(u32 _width, u32 _height, Texture _charSheet, u8 _charResolution)
+        : CharGrid(_width, _height) {
+        charSheet      = _charSheet;
+        charResolution = _charResolution;
+    }
+
+    CharGrid(const CharGrid&)            = delete;
+    CharGrid& operator=(const CharGrid&) = delete;
+
+    // The charsheet isn't ours.
+    ~CharGrid() {
+        if (glyphTexture.id) {
+            UnloadTexture(glyphTexture);
+            UnloadTexture(foregroundTexture);
+            UnloadTexture(backgroundTexture);
+            UnloadShader(shader);
+        }
+    }
+
+    void Set(u32 x, u32 y, u16 glyph) {
+        glyphs[x + y * width] = glyph;
+        dirtyRows[y]          = 1;
+    }
+
+    void Set(u32 x, u32 y, u16 glyph, Color fg, Color bg) {
+        const u32 i   = x + y * width;
+        glyphs[i]     = glyph;
+        foreground[i] = fg;
+        background[i] = bg;
+        dirtyRows[y]  = 1;
+    }
+
+    // Writes a run of glyphs from (x, y) rightwards, clipped to the row.
+    void Print(u32 x, u32 y, const u16* text, u32 count, Color fg, Color bg) {
+        for (u32 i = 0; i < count && x + i < width; i++) Set(x + i, y, text[i], fg, bg);
+    }
+
+    void Clear(Color bg = BLACK) {
+        std::fill(glyphs.begin(), glyphs.end(), 0);
+        std::fill(background.begin(), background.end(), bg);
+        std::fill(dirtyRows.begin(), dirtyRows.end(), 1);
+    }
 
-    CharGrid(u32 _width) : width{_width}, height{_width}, chars{(u8*)malloc(width * height)} {}
+    // For writing to the buffers directly.
+    void MarkDirty(u32 y) { dirtyRows[y] = 1; }
+
+    void Draw(Rectangle dest) {
+        if (!glyphTexture.id)
+            load();
+        upload();
+
+        const v2 gridSize{(f32)width, (f32)height};
+        const v2 sheetSize{(f32)charSheet.width / charResolution,
+                           (f32)charSheet.height / charResolution};
+
+        BeginShaderMode(shader);
+        SetShaderValue(shader, gridSizeLoc, &gridSize, SHADER_UNIFORM_VEC2);
+        SetShaderValue(shader, sheetSizeLoc, &sheetSize, SHADER_UNIFORM_VEC2);
+        SetShaderValueTexture(shader, foregroundLoc, foregroundTexture);
+        SetShaderValueTexture(shader, backgroundLoc, backgroundTexture);
+        SetShaderValueTexture(shader, charSheetLoc, charSheet);
+        DrawTexturePro(
+            glyphTexture, Rectangle{0, 0, (f32)width, (f32)height}, dest, v2{}, 0, WHITE);
+        EndShaderMode();
+    }
 
-    void Set(u8 x, u8 y, u8 to) { chars[x * y] = to; }
-};
\ No newline at end of file
+    // One glyph per charsheet pixel, at the origin.
+    void Draw() {
+        Draw(Rectangle{0, 0, (f32)width * charResolution, (f32)height * charResolution});
+    }
+};
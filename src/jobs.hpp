@@ -0,0 +1,348 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+
+#include "profiler.hpp"
+
+#define JOB_DEQUE_SIZE 4096     // Jobs per worker deque, a power of two
+#define JOB_MAX_CHUNKS 256      // Most jobs a single ParallelFor splits into
+#define JOB_DEFAULT_GRAIN 4096  // Fewest items per ParallelFor chunk
+
+// Number of jobs still running under a parent, for fork-join. Every job submitted against a counter
+// bumps it and brings it back down when done; JobSystem::Wait() returns once it reaches zero.
+struct JobCounter {
+    std::atomic<u32> count{0};
+};
+
+// A unit of work: function(job), where the job carries an index and a range for ParallelFor and a
+// context pointer for the callable. Jobs don't own anything. The job and whatever its context
+// points to must stay alive until its counter has been waited on, which fork-join guarantees when
+// both live on the stack of the function doing the waiting.
+struct Job {
+    void (*function)(const Job&) = nullptr;
+    void*       context          = nullptr;
+    usize       index = 0, begin = 0, end = 0;
+    JobCounter* counter = nullptr;
+
+    // A job calling context(index, begin, end).
+    template <typename F>
+    static Job For(F& callable, usize index = 0, usize begin = 0, usize end = 0) {
+        using Callable = std::remove_reference_t<F>;
+        return Job{[](const Job& job) {
+                       (*static_cast<Callable*>(job.context))(job.index, job.begin, job.end);
+                   },
+                   const_cast<void*>(static_cast<const void*>(&callable)),
+                   index,
+                   begin,
+                   end};
+    }
+};
+
+// Chase-Lev work-stealing deque. Its owning worker pushes and pops jobs at the bottom, LIFO, while
+// any other thread may steal from the top, FIFO, without locks. Bounded: Push() fails when full.
+class JobDeque {
+    static constexpr i64 mask = JOB_DEQUE_SIZE - 1;
+    static_assert((JOB_DEQUE_SIZE & mask) == 0, "JOB_DEQUE_SIZE must be a power of two");
+
+    alignas(64) std::atomic<i64> top{0};
+    alignas(64) std::atomic<i64> bottom{0};
+    std::atomic<Job*> jobs[JOB_DEQUE_SIZE];
+
+   public:
+    // Owner only.
+    bool Push(Job* job) {
+        const i64 b = bottom.load(std::memory_order_relaxed);
+        const i64 t = top.load(std::memory_order_acquire);
+        if (b - t > mask)
+            return false;
+
+        jobs[b & mask].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only.
+    Job* Pop() {
+        const i64 b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = jobs[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last job: race thieves for it.
+            if (!top.compare_exchange_strong(
+                    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread.
+    Job* Steal() {
+        i64 t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const i64 b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+
+        Job* job = jobs[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+};
+
+// Work-stealing job scheduler. Each worker thread owns a JobDeque: jobs submitted from a worker go
+// to its own deque and idle workers steal from the others. Threads that aren't workers, such as the
+// main thread, submit through a shared queue instead. Waiting on a counter runs other jobs in the
+// meantime, so jobs can fork and join their own children without tying up a worker.
+class JobSystem {
+    std::vector<std::unique_ptr<JobDeque>> deques;
+
+    std::mutex       sharedLock;
+    std::deque<Job*> shared;  // From threads that aren't workers
+
+    std::atomic<u32>          signal{0};  // Bumped on every submission, for sleeping workers
+    std::vector<std::jthread> workers;    // Last, so they stop before the deques go away
+
+    static inline thread_local const JobSystem* owner  = nullptr;
+    static inline thread_local usize            worker = 0;
+
+    bool isWorker() const { return owner == this; }
+
+    static void execute(Job* job) {
+        job->function(*job);
+        // Last touch: once this reaches zero the waiter may free the job.
+        job->counter->count.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    Job* find() {
+        if (isWorker())
+            if (Job* job = deques[worker]->Pop())
+                return job;
+
+        {
+            std::lock_guard lock{sharedLock};
+            if (!shared.empty()) {
+                Job* job = shared.front();
+                shared.pop_front();
+                return job;
+            }
+        }
+
+        // Victims in turn, starting next to the thief so they don't all hit the same deque.
+        const usize start = isWorker() ? worker + 1 : 0;
+        for (usize i = 0; i < deques.size(); i++)
+            if (Job* job = deques[(start + i) % deques.size()]->Steal())
+                return job;
+
+        return nullptr;
+    }
+
+    void work(std::stop_token stop, usize index) {
+        owner  = this;
+        worker = index;
+        Profiler::SetThreadName(std::format("Job worker {}", index));
+
+        while (true) {
+            // Stop is checked after loading seen: a stop requested later also bumps signal after
+            // it (see ~JobSystem), so the wait below can't miss it and sleep forever.
+            const u32 seen = signal.load(std::memory_order_acquire);
+            if (stop.stop_requested())
+                return;
+            if (Job* job = find()) {
+                execute(job);
+                continue;
+            }
+            signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    void wake(bool all) {
+        signal.fetch_add(1, std::memory_order_release);
+        if (all)
+            signal.notify_all();
+        else
+            signal.notify_one();
+    }
+
+   public:
+    explicit JobSystem(u32 threads = std::max(std::thread::hardware_concurrency(), 2u) - 1) {
+        threads = std::max(threads, 1u);
+        for (u32 i = 0; i < threads; i++) deques.push_back(std::make_unique<JobDeque>());
+        for (u32 i = 0; i < threads; i++)
+            workers.emplace_back([this, i](std::stop_token stop) { work(stop, i); });
+    }
+
+    JobSystem(const JobSystem&)            = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    ~JobSystem() {
+        for (auto& thread : workers) thread.request_stop();
+        wake(true);
+        workers.clear();
+    }
+
+    // Threads running jobs: the workers, plus whichever thread is waiting.
+    u32 Concurrency() const { return workers.size() + 1; }
+
+    // Queues count jobs as children of counter.
+    void Submit(Job* jobs, usize count, JobCounter& counter) {
+        counter.count.fetch_add(count, std::memory_order_relaxed);
+        for (usize i = 0; i < count; i++) jobs[i].counter = &counter;
+
+        if (isWorker()) {
+            for (usize i = 0; i < count; i++)
+                if (!deques[worker]->Push(&jobs[i]))
+                    execute(&jobs[i]);  // Deque full, so run it here instead
+        } else {
+            std::lock_guard lock{sharedLock};
+            for (usize i = 0; i < count; i++) shared.push_back(&jobs[i]);
+        }
+        wake(count > 1);
+    }
+
+    void Submit(Job& job, JobCounter& counter) { Submit(&job, 1, counter); }
+
+    // Runs other jobs until every child of counter is done.
+    void Wait(JobCounter& counter) {
+        while (counter.count.load(std::memory_order_acquire) > 0) {
+            if (Job* job = find())
+                execute(job);
+            else
+                std::this_thread::yield();
+        }
+    }
+};
+
+// The engine's job system, started on first use.
+JobSystem& Jobs() {
+    static JobSystem system;
+    return system;
+}
+
+// Splits [0, count) into contiguous chunks of at least grain items and runs
+// body(chunk, begin, end) on each in parallel, returning once all are done. Returns the number of
+// chunks, at most JOB_MAX_CHUNKS, so callers can keep one partial result per chunk.
+template <typename F>
+usize ParallelChunks(usize count, usize grain, F&& body) {
+    if (count == 0)
+        return 0;
+
+    const usize chunks = std::min<usize>({(count + std::max<usize>(grain, 1) - 1) /
+                                              std::max<usize>(grain, 1),
+                                          JOB_MAX_CHUNKS,
+                                          4 * (usize)Jobs().Concurrency()});
+    if (chunks == 1) {
+        body(0, 0, count);
+        return 1;
+    }
+
+    Job        jobs[JOB_MAX_CHUNKS];
+    JobCounter counter;
+    for (usize c = 0; c < chunks; c++)
+        jobs[c] = Job::For(body, c, c * count / chunks, (c + 1) * count / chunks);
+
+    Jobs().Submit(jobs, chunks, counter);
+    Jobs().Wait(counter);
+    return chunks;
+}
+
+// Runs body(begin, end) over chunks of [0, count) in parallel.
+template <typename F>
+void ParallelFor(usize count, F&& body, usize grain = JOB_DEFAULT_GRAIN) {
+    ParallelChunks(count, grain, [&body](usize, usize begin, usize end) { body(begin, end); });
+}
+
+// Runs body(begin, end) over chunks of the array's elements in parallel.
+template <typename T, typename F>
+void ParallelFor(const Array<T>& array, F&& body, usize grain = JOB_DEFAULT_GRAIN) {
+    ParallelFor(array.count, body, grain);
+}
+
+// Same as Array<T>::Max().
+template <typename T>
+T ParallelMax(const Array<T>& array, usize grain = JOB_DEFAULT_GRAIN) {
+    assert(array.count > 0);
+
+    T           partial[JOB_MAX_CHUNKS];
+    const usize chunks = ParallelChunks(array.count, grain, [&](usize c, usize begin, usize end) {
+        T result = array.buffer[begin];
+        for (usize i = begin; i < end; i++)
+            if (array.buffer[i] > result)
+                result = array.buffer[i];
+        partial[c] = result;
+    });
+
+    return *std::max_element(partial, partial + chunks);
+}
+
+// Same as Array<T>::Min().
+template <typename T>
+T ParallelMin(const Array<T>& array, usize grain = JOB_DEFAULT_GRAIN) {
+    assert(array.count > 0);
+
+    T           partial[JOB_MAX_CHUNKS];
+    const usize chunks = ParallelChunks(array.count, grain, [&](usize c, usize begin, usize end) {
+        T result = array.buffer[begin];
+        for (usize i = begin; i < end; i++)
+            if (array.buffer[i] < result)
+                result = array.buffer[i];
+        partial[c] = result;
+    });
+
+    return *std::min_element(partial, partial + chunks);
+}
+
+// Largest difference between consecutive values once sorted, in O(n) like Array<T>::MaxGap(): the
+// n - 2 values strictly between min and max go into n - 1 equal buckets, so the gap is between
+// buckets and only each bucket's extremes matter. Buckets are filled in parallel with atomic min
+// and max, and bucket widths are fractional, which avoids the rounding of the serial version.
+template <typename T>
+T ParallelMaxGap(const Array<T>& array, usize grain = JOB_DEFAULT_GRAIN) {
+    assert(array.count > 1);
+
+    const T min = ParallelMin(array, grain);
+    const T max = ParallelMax(array, grain);
+    if (max == min)
+        return 0;
+
+    const usize    buckets = array.count - 1;
+    const f64      width   = (f64)(max - min) / buckets;
+    std::vector<T> lows(buckets, max), highs(buckets, min);  // Empty while low > high
+
+    ParallelFor(array, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) {
+            const T value = array.buffer[i];
+            if (value == min || value == max)
+                continue;
+
+            const usize bucket = std::min((usize)((value - min) / width), buckets - 1);
+
+            std::atomic_ref<T> low{lows[bucket]}, high{highs[bucket]};
+            T current = low.load(std::memory_order_relaxed);
+            while (value < current && !low.compare_exchange_weak(current, value)) {}
+            current = high.load(std::memory_order_relaxed);
+            while (value > current && !high.compare_exchange_weak(current, value)) {}
+        }
+    }, grain);
+
+    T gap = 0, previous = min;
+    for (usize b = 0; b < buckets; b++) {
+        if (lows[b] > highs[b])
+            continue;
+        gap      = std::max(gap, lows[b] - previous);
+        previous = highs[b];
+    }
+    return std::max(gap, max - previous);
+}
@@ -3,42 +3,226 @@
 #include <emscripten/html5.h>
 #endif
 
-#if defined(PLATFORM_DESKTOP)
-#define GLSL_VERSION 330
-#else  // PLATFORM_ANDROID, PLATFORM_WEB
-#define GLSL_VERSION 100
-#endif
-
+#include "testing.hpp"
 #include "textmode.hpp"
 
+static AssetManager    assets;
+static TilesetRegistry tilesets{assets, "../assets/tilesets"};
+static FixedTimestep   timestep{SIMULATION_RATE};
+static FrameWorker     simulation;  // Ticks of pipelined scenes
+
+// Scenes are built the first time they're shown, and load their assets in the background.
+static std::function<Scene*()> SceneFactories[] = {
+    [] { return (Scene*)new MainMenu(); },
+    [] { return (Scene*)new TileEditor(assets, tilesets.Get("MRMOTEXT-EX"), v2{40, 20}); },
+    [] { return (Scene*)new ConvexHullTesting(); },
+    [] { return (Scene*)new AutomataTesting(); },
+};
+static Scene* Scenes[std::size(SceneFactories)]{};
+
+Scene* GetScene(usize index) {
+    if (!Scenes[index])
+        Scenes[index] = SceneFactories[index]();
+    return Scenes[index];
+}
+
 void Update() {
-    static Array<Scene*> Scenes{
-        new MainMenu(),
-        new TileEditor("D:\\Dev\\Motley\\assets\\tilesets\\MRMOTEXT-EX.png", 8, 32, v2{40, 20})};
     static usize current = 0;
 
+    Profiler::FrameMark();
+    MemoryTelemetry::FrameMark();
+    PROFILE_ZONE("Frame");
+
+    // The ticks started last frame, if pipelined.
+    {
+        PROFILE_ZONE("Wait for simulation");
+        simulation.Wait();
+    }
+
+    if (IsKeyPressed(KEY_F3))
+        Profiler::showOverlay = !Profiler::showOverlay;
+    if (IsKeyPressed(KEY_F4))
+        Profiler::ExportChromeTrace();
+    if (IsKeyPressed(KEY_F5))
+        Profiler::showMemory = !Profiler::showMemory;
+    if (IsKeyPressed(KEY_F6))
+        MemoryTelemetry::DumpCsv();
+
     if (IsKeyPressed(KEY_SPACE)) {
-        current = (current + 1) % Scenes.count;
+        GetScene(current)->Exit();
+        current = (current + 1) % std::size(Scenes);
     }
 
-    Scene* scene = Scenes[current];
+    Scene* scene = GetScene(current);
 
-    scene->Compute();
+    {
+        PROFILE_ZONE("Assets");
+        assets.Update();
+    }
+
+    auto compute = [scene] {
+        PROFILE_ZONE("Compute");
+        scene->Compute();
+    };
+
+    if (scene->pipelined) {
+        scene->Publish();
+        {
+            PROFILE_ZONE("Input");
+            scene->Input();
+        }
+
+        u32 ticks = timestep.Consume(GetFrameTime());
+        simulation.Start([compute, ticks] { timestep.Run(ticks, compute); });
+    } else {
+        {
+            PROFILE_ZONE("Input");
+            scene->Input();
+        }
+        timestep.Advance(GetFrameTime(), compute);
+    }
 
     BeginDrawing();
     {
         ClearBackground(RAYWHITE);
 
-        BeginMode2D(scene->camera);
-        scene->Draw2D();
+        BeginMode2D(scene->camera.Interpolated(timestep.Alpha()));
+        {
+            PROFILE_ZONE("Draw2D");
+            scene->Draw2D();
+        }
         EndMode2D();
 
-        scene->DrawUI();
+        {
+            PROFILE_ZONE("DrawUI");
+            scene->DrawUI();
+        }
+
+        if (Profiler::showOverlay)
+            Profiler::DrawOverlay(Rectangle{10, screenHeight - 330.0f, screenWidth - 20.0f, 320});
+        if (Profiler::showMemory)
+            Profiler::DrawMemoryOverlay(Rectangle{screenWidth - 510.0f, 10, 500, 360});
+    }
+    {
+        PROFILE_ZONE("EndDrawing");
+        EndDrawing();
+    }
+}
+
+// Steps a scene's simulation as fast as it goes, with nothing drawn, and prints the tick rate and
+// how much the ticks allocated. Ticks still advance by the fixed tick length, so the simulation is
+// the same as when windowed. One tick runs first as a warm up, outside the measurements. Returns
+// false if failOnAllocation and a measured tick allocated from the heap.
+bool RunHeadless(usize index, u64 ticks, bool failOnAllocation) {
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(screenWidth, screenHeight, "EngineTest");
+
+    Scene* scene = GetScene(index);
+    while (assets.Pending() > 0) assets.Update();
+
+    SimulationClock::tick = timestep.delta;
+    scene->Compute();
+    MemoryTelemetry::FrameMark();
+
+    auto start = ch::steady_clock::now();
+    for (u64 i = 0; i < ticks; i++) scene->Compute();
+    f64 seconds = ch::duration<f64>(ch::steady_clock::now() - start).count();
+
+    SimulationClock::tick = 0;
+    MemoryTelemetry::FrameMark();
+    const FrameMemory memory = MemoryTelemetry::Frame();
+
+    std::cout << std::format("INFO: BENCH: Scene {}, {} ticks: {:.3f}s, {:.1f} ticks/s, "
+                             "{:.3f}ms/tick\n",
+                             index,
+                             ticks,
+                             seconds,
+                             ticks / seconds,
+                             seconds * 1000 / ticks);
+    std::cout << std::format("INFO: BENCH: {:.2f} heap allocations ({:.0f} B) and {:.2f} arena "
+                             "allocations ({:.0f} B) per tick\n",
+                             (f64)memory.heapAllocations / ticks,
+                             (f64)memory.heapBytes / ticks,
+                             (f64)memory.arenaAllocations / ticks,
+                             (f64)memory.arenaBytes / ticks);
+    tilesets.Unload();
+    CloseWindow();
+
+#if !defined(MEMORY_TELEMETRY)
+    if (failOnAllocation)
+        std::cout << "WARNING: BENCH: Heap allocations are only counted with MEMORY_TELEMETRY\n";
+#endif
+    return !failOnAllocation || memory.heapAllocations == 0;
+}
+
+// argv[index] as a number, or fallback if there are fewer arguments. Empty, after printing an
+// error, if it isn't one.
+template <typename T>
+std::optional<T> ParseArgument(i32 argc, char** argv, i32 index, T fallback) {
+    if (index >= argc)
+        return fallback;
+
+    const char* first = argv[index];
+    const char* last  = first + strlen(first);
+    T           value{};
+    auto [end, error] = std::from_chars(first, last, value);
+    if (error != std::errc{} || end != last) {
+        std::cout << "ERROR: ENGINE: Not a valid number: " << first << "\n";
+        return std::nullopt;
     }
-    EndDrawing();
+    return value;
 }
 
-int main() {
+// EngineTest [--headless [scene] [ticks] [--fail-on-alloc]]
+//            [--bench-automata [size] [generations] [threads] [rule]]
+//            [--check]
+// Scenes are numbered as in SceneFactories: 0 menu, 1 tile editor, 2 convex hulls, 3 automata.
+// F3 toggles the profiler overlay and F4 writes a Chrome trace to PROFILER_TRACE_PATH. F5 toggles
+// the memory overlay and F6 writes the memory telemetry to MEMORY_CSV_PATH.
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--headless") {
+        bool failOnAllocation = std::string(argv[argc - 1]) == "--fail-on-alloc";
+        if (failOnAllocation)
+            argc--;
+
+        auto scene = ParseArgument<usize>(argc, argv, 2, 0);
+        auto ticks = ParseArgument<u64>(argc, argv, 3, 10000);
+        if (!scene || !ticks)
+            return 1;
+        if (*scene >= std::size(Scenes)) {
+            std::cout << "ERROR: ENGINE: No scene " << *scene << ", there are "
+                      << std::size(Scenes) << "\n";
+            return 1;
+        }
+
+        return RunHeadless(*scene, std::max<u64>(*ticks, 1), failOnAllocation) ? 0 : 1;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-automata") {
+        auto size        = ParseArgument<u32>(argc, argv, 2, 4096);
+        auto generations = ParseArgument<u32>(argc, argv, 3, 200);
+        auto threads     = ParseArgument<u32>(argc, argv, 4, std::thread::hardware_concurrency());
+        if (!size || !generations || !threads)
+            return 1;
+
+        AutomataTesting::RunBenchmark(std::max(*size, 1u),
+                                      std::max(*generations, 1u),
+                                      argc > 5 ? argv[5] : "B3/S23",
+                                      *threads);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--check") {
+        bool passed = CheckParallelReductions();
+        passed      = CheckColumnWriter() && passed;
+        passed      = CheckConvexHulls() && passed;
+        std::cout << (passed ? "INFO: ENGINE: All checks passed\n"
+                             : "ERROR: ENGINE: Checks failed\n");
+        return passed ? 0 : 1;
+    }
+
+    Profiler::SetThreadName("Main");
+
     // SetConfigFlags(FLAG_MSAA_4X_HINT);
     InitWindow(screenWidth, screenHeight, "EngineTest");
     SetTargetFPS(60);
@@ -47,5 +231,6 @@ int main() {
         Update();
     }
 
+    tilesets.Unload();
     CloseWindow();
-}
\ No newline at end of file
+}
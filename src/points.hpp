@@ -0,0 +1,269 @@
+#pragma once
+
+#include "jobs.hpp"
+
+#define POINTS_PER_BLOCK 4096  // Points generated from each seed in GeneratePoints
+#define POINTS_BATCH 256       // Points whose random numbers are drawn at once
+#define POINTS_DEFAULT_SEED 0x5EED
+
+// Seeds generators from a single number: SplitMix64, the recommended seeder of the xoshiro family.
+struct SplitMix64 {
+    u64 state;
+
+    explicit SplitMix64(u64 seed) : state(seed) {}
+
+    u64 Next() {
+        u64 z = (state += 0x9E3779B97F4A7C15ull);
+        z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z     = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+// Top 24 bits of a random number as a float in [0, 1).
+f32 UnitFloat(u64 bits) {
+    return (bits >> 40) * 0x1.0p-24f;
+}
+
+u64 Rotl(u64 x, i32 k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256+, fast with a 2^256 period. Its lowest bits are weak, which floats never see.
+struct Xoshiro256 {
+    using result_type = u64;
+
+    u64 s[4];
+
+    explicit Xoshiro256(u64 seed) {
+        SplitMix64 seeder(seed);
+        for (u64& word : s) word = seeder.Next();
+    }
+
+    static constexpr u64 min() { return 0; }
+    static constexpr u64 max() { return UINT64_MAX; }
+
+    u64 operator()() {
+        const u64 result = s[0] + s[3];
+        const u64 t      = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 45);
+        return result;
+    }
+
+    f32 Float() { return UnitFloat((*this)()); }
+
+    void Fill(f32* out, usize count) {
+        for (usize i = 0; i < count; i++) out[i] = Float();
+    }
+};
+
+// Four xoshiro256+ streams side by side, state laid out by word so each step is the same operation
+// on four lanes, which the compiler turns into vector instructions.
+struct Xoshiro256x4 {
+    alignas(32) u64 s0[4], s1[4], s2[4], s3[4];
+
+    explicit Xoshiro256x4(u64 seed) {
+        SplitMix64 seeder(seed);
+        for (u32 lane = 0; lane < 4; lane++) {
+            s0[lane] = seeder.Next();
+            s1[lane] = seeder.Next();
+            s2[lane] = seeder.Next();
+            s3[lane] = seeder.Next();
+        }
+    }
+
+    void Next(u64 (&out)[4]) {
+        for (u32 lane = 0; lane < 4; lane++) {
+            out[lane]   = s0[lane] + s3[lane];
+            const u64 t = s1[lane] << 17;
+            s2[lane] ^= s0[lane];
+            s3[lane] ^= s1[lane];
+            s1[lane] ^= s2[lane];
+            s0[lane] ^= s3[lane];
+            s2[lane] ^= t;
+            s3[lane] = Rotl(s3[lane], 45);
+        }
+    }
+
+    void Fill(f32* out, usize count) {
+        u64 bits[4];
+        for (usize i = 0; i < count; i += 4) {
+            Next(bits);
+            for (u32 lane = 0; lane < 4 && i + lane < count; lane++)
+                out[i + lane] = UnitFloat(bits[lane]);
+        }
+    }
+};
+
+// PCG32 (XSH RR), small state and good statistical quality.
+struct Pcg32 {
+    using result_type = u32;
+
+    u64 state = 0, increment;
+
+    explicit Pcg32(u64 seed, u64 stream = 0xDA3E39CB94B95BDBull) : increment((stream << 1) | 1) {
+        (*this)();
+        state += SplitMix64(seed).Next();
+        (*this)();
+    }
+
+    static constexpr u32 min() { return 0; }
+    static constexpr u32 max() { return UINT32_MAX; }
+
+    u32 operator()() {
+        const u64 old = state;
+        state         = old * 6364136223846793005ull + increment;
+        const u32 xorshifted = (u32)(((old >> 18) ^ old) >> 27);
+        const u32 rotation   = (u32)(old >> 59);
+        return (xorshifted >> rotation) | (xorshifted << ((-rotation) & 31));
+    }
+
+    f32 Float() { return ((*this)() >> 8) * 0x1.0p-24f; }
+
+    void Fill(f32* out, usize count) {
+        for (usize i = 0; i < count; i++) out[i] = Float();
+    }
+};
+
+enum class PointDistribution {
+    Uniform,    // Anywhere in the bounds
+    Disk,       // Uniform over the largest disk in the bounds
+    Circle,     // On that disk's edge, so every point is on the hull
+    Clusters,   // Gaussian blobs around centers picked from the seed
+    Grid,       // One per cell of a grid over the bounds, moved randomly within its cell
+    Collinear,  // On the edges of the bounds, so hull edges have many points in line
+    Count
+};
+
+static const char* PointDistributionNames[] = {
+    "Uniform", "Disk", "Circle", "Clusters", "Grid", "Collinear"};
+
+// What GeneratePoints() makes. The same cloud and count always give the same points.
+struct PointCloud {
+    PointDistribution distribution = PointDistribution::Uniform;
+    Rectangle         bounds{0, 0, 1, 1};
+    u64               seed     = POINTS_DEFAULT_SEED;
+    u32               clusters = 8;      // Clusters: how many
+    f32               spread   = 0.05f;  // Clusters: standard deviation, in bounds
+    f32               jitter   = 0.5f;   // Grid: how far from the cell center, in cells
+};
+
+// Turns pairs of uniform numbers into points of the cloud. Everything but the Clusters centers is
+// derived from the point's index, so it doesn't matter which block makes which point.
+class PointShaper {
+    const PointCloud& cloud;
+    v2                center;
+    f32               radius;
+    u32               columns = 1;
+    v2                cell{1, 1};
+    std::vector<v2>   centers;
+
+   public:
+    PointShaper(const PointCloud& _cloud, usize count)
+        : cloud{_cloud},
+          center{_cloud.bounds.x + _cloud.bounds.width / 2,
+                 _cloud.bounds.y + _cloud.bounds.height / 2},
+          radius{std::min(_cloud.bounds.width, _cloud.bounds.height) / 2} {
+        const Rectangle& bounds = cloud.bounds;
+        if (cloud.distribution == PointDistribution::Grid) {
+            const f32 aspect = bounds.width / std::max(bounds.height, FLT_MIN);
+            columns          = std::max(1u, (u32)std::ceil(std::sqrt(count * aspect)));
+            const u32 rows   = std::max<usize>(1, (count + columns - 1) / columns);
+            cell             = v2{bounds.width / columns, bounds.height / rows};
+        }
+
+        if (cloud.distribution == PointDistribution::Clusters) {
+            Xoshiro256 rng(cloud.seed ^ 0xC1A57E25ull);
+            for (u32 i = 0; i < std::max(cloud.clusters, 1u); i++)
+                centers.push_back(v2{bounds.x + (0.1f + 0.8f * rng.Float()) * bounds.width,
+                                     bounds.y + (0.1f + 0.8f * rng.Float()) * bounds.height});
+        }
+    }
+
+    v2 operator()(usize index, f32 u, f32 v) const {
+        const Rectangle& bounds = cloud.bounds;
+        switch (cloud.distribution) {
+            case PointDistribution::Disk: {
+                const f32 r = radius * std::sqrt(u), angle = 2 * PI * v;
+                return v2{center.x + r * std::cos(angle), center.y + r * std::sin(angle)};
+            }
+
+            case PointDistribution::Circle:
+                return v2{center.x + radius * std::cos(2 * PI * u),
+                          center.y + radius * std::sin(2 * PI * u)};
+
+            case PointDistribution::Clusters: {
+                // Box-Muller, with u moved off 0 so the log stays finite.
+                const f32 r     = std::sqrt(-2 * std::log(1 - u)), angle = 2 * PI * v;
+                const f32 sigma = cloud.spread * std::min(bounds.width, bounds.height);
+                const v2& mean  = centers[index % centers.size()];
+                return v2{mean.x + sigma * r * std::cos(angle),
+                          mean.y + sigma * r * std::sin(angle)};
+            }
+
+            case PointDistribution::Grid: {
+                const f32 column = index % columns, row = index / columns;
+                return v2{bounds.x + (column + 0.5f + cloud.jitter * (u - 0.5f)) * cell.x,
+                          bounds.y + (row + 0.5f + cloud.jitter * (v - 0.5f)) * cell.y};
+            }
+
+            case PointDistribution::Collinear: {
+                // Exactly on one of the four edges, every eighth point on a corner.
+                const f32 along = (index % 8 == 0) ? 0 : u;
+                switch ((u32)(v * 4) & 3) {
+                    case 0: return v2{bounds.x + along * bounds.width, bounds.y};
+                    case 1: return v2{bounds.x + bounds.width, bounds.y + along * bounds.height};
+                    case 2: return v2{bounds.x + along * bounds.width, bounds.y + bounds.height};
+                    default: return v2{bounds.x, bounds.y + along * bounds.height};
+                }
+            }
+
+            default:
+                return v2{bounds.x + u * bounds.width, bounds.y + v * bounds.height};
+        }
+    }
+};
+
+// Fills points with count points of the cloud, in parallel. Each block of POINTS_PER_BLOCK points
+// has its own generator seeded from the cloud's seed and the block, so the result depends only on
+// the seed, never on how many threads there are. Rng is any generator constructible from a seed
+// with a Fill(f32*, count) of uniform floats in [0, 1).
+template <typename Rng = Xoshiro256x4>
+void GeneratePoints(const PointCloud& cloud, Array<v2>& points, usize count) {
+    assert(count <= points.size);
+    points.count = count;
+
+    const PointShaper shape(cloud, count);
+    const usize       blocks = (count + POINTS_PER_BLOCK - 1) / POINTS_PER_BLOCK;
+    ParallelFor(blocks, [&](usize begin, usize end) {
+        f32 uniforms[POINTS_BATCH * 2];
+        for (usize block = begin; block < end; block++) {
+            Rng rng(SplitMix64(cloud.seed + block * 0x9E3779B97F4A7C15ull).Next());
+
+            const usize last = std::min(count, (block + 1) * POINTS_PER_BLOCK);
+            for (usize first = block * POINTS_PER_BLOCK; first < last; first += POINTS_BATCH) {
+                const usize batch = std::min<usize>(POINTS_BATCH, last - first);
+                rng.Fill(uniforms, batch * 2);
+                for (usize i = 0; i < batch; i++)
+                    points.buffer[first + i] =
+                        shape(first + i, uniforms[i * 2], uniforms[i * 2 + 1]);
+            }
+        }
+    }, 1);
+}
+
+// Same, into a new array from the caller's arena.
+template <typename Rng = Xoshiro256x4>
+Array<v2> GeneratePoints(const PointCloud&    cloud,
+                         usize                count,
+                         Arena&               arena,
+                         std::source_location where = std::source_location::current()) {
+    Array<v2> points(count, &arena, where);
+    GeneratePoints<Rng>(cloud, points, count);
+    return points;
+}
@@ -0,0 +1,430 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_TSC
+#endif
+
+#include <atomic>
+#include <map>
+
+#include "engine.hpp"
+
+#define PROFILER_RING_SIZE 16384     // Zones kept per thread, a power of two
+#define PROFILER_FRAMES 256          // Frame starts kept
+#define PROFILER_OVERLAY_FRAMES 3    // Frames shown on the overlay's timeline
+#define PROFILER_TRACE_PATH "../benchmarks/trace.json"
+
+struct ProfileEvent {
+    const char* name;
+    u64         start, end;  // Profiler::Now() ticks
+    u32         depth;       // Zones open around this one on the same thread
+};
+
+// Zones recorded by one thread. Only that thread writes, into a ring that overwrites the oldest
+// zones; readers copy zones out and drop the ones overwritten while they were reading.
+struct ProfileRing {
+    static constexpr u64 mask = PROFILER_RING_SIZE - 1;
+    static_assert((PROFILER_RING_SIZE & mask) == 0, "PROFILER_RING_SIZE must be a power of two");
+
+    std::string      name;
+    u32              id;
+    u32              depth = 0;  // Owner only
+    std::atomic<u64> head{0};    // Zones ever recorded
+    ProfileEvent     events[PROFILER_RING_SIZE];
+
+    void Record(const ProfileEvent& event) {
+        const u64 h      = head.load(std::memory_order_relaxed);
+        events[h & mask] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Calls f(event) on every zone still in the ring that ended at or after since.
+    template <typename F>
+    void ForEach(u64 since, F&& f) const {
+        const u64 h = head.load(std::memory_order_acquire);
+        for (u64 i = h > PROFILER_RING_SIZE ? h - PROFILER_RING_SIZE : 0; i < h; i++) {
+            const ProfileEvent event = events[i & mask];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // Once head reaches i + PROFILER_RING_SIZE the owner may be writing over slot i.
+            if (head.load(std::memory_order_relaxed) >= i + PROFILER_RING_SIZE)
+                continue;  // Overwritten while copying
+
+            if (event.end >= since)
+                f(event);
+        }
+    }
+};
+
+// Frame profiler. Time spent in PROFILE_ZONE scopes is recorded, per thread, without locks, in
+// ticks of the CPU's timestamp counter where there is one and of steady_clock otherwise. Ticks
+// are converted to time only for display and export, calibrated against steady_clock over the
+// whole run so far. The main loop marks where frames start.
+//
+// DrawOverlay() shows a timeline of the last frames with min/avg/max per zone, and
+// ExportChromeTrace() writes every zone still recorded as a trace for chrome://tracing or Perfetto.
+class Profiler {
+   public:
+    static u64 Now() {
+#if defined(PROFILER_TSC)
+        return __rdtsc();
+#else
+        return ch::duration_cast<ch::nanoseconds>(ch::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+   private:
+    static inline std::mutex                lock;
+    static inline std::vector<ProfileRing*> rings;  // Never freed, as threads may outlive us
+    static inline thread_local ProfileRing* local = nullptr;
+
+    static inline u64 frames[PROFILER_FRAMES];
+    static inline u64 frameCount = 0;
+
+    static inline const u64                      originTicks = Now();
+    static inline const ch::steady_clock::time_point originTime  = ch::steady_clock::now();
+
+    // Nanoseconds per tick, measured over the time since startup and fixed once that's a second.
+    static f64 nanosecondsPerTick() {
+#if defined(PROFILER_TSC)
+        static f64 fixed = 0;
+        if (fixed > 0)
+            return fixed;
+
+        ch::nanoseconds elapsed;
+        u64             ticks;
+        do {
+            elapsed = ch::steady_clock::now() - originTime;
+            ticks   = Now() - originTicks;
+        } while (elapsed < ch::milliseconds(10));
+
+        const f64 rate = (f64)elapsed.count() / ticks;
+        if (elapsed > ch::seconds(1))
+            fixed = rate;
+        return rate;
+#else
+        return 1;
+#endif
+    }
+
+    static Color colorOf(const char* name) {
+        return ColorFromHSV((f32)(std::hash<std::string_view>{}(name) % 360), 0.45f, 0.9f);
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+   public:
+    static inline bool showOverlay = false;
+    static inline bool showMemory  = false;
+
+    static f64 Milliseconds(u64 ticks) { return ticks * nanosecondsPerTick() / 1e6; }
+
+    // This thread's ring, made on first use.
+    static ProfileRing& Ring() {
+        if (!local) {
+            std::lock_guard guard{lock};
+            local       = new ProfileRing{};
+            local->id   = rings.size();
+            local->name = std::format("Thread {}", local->id);
+            rings.push_back(local);
+        }
+        return *local;
+    }
+
+    static void SetThreadName(std::string name) {
+        ProfileRing&    ring = Ring();
+        std::lock_guard guard{lock};
+        ring.name = std::move(name);
+    }
+
+    // Main thread only.
+    static void FrameMark() { frames[frameCount++ % PROFILER_FRAMES] = Now(); }
+
+    // Timeline of the last PROFILER_OVERLAY_FRAMES whole frames, one lane per thread and one row
+    // per zone depth, above the min/avg/max of each zone over those frames. Main thread only.
+    static void DrawOverlay(Rectangle bounds) {
+        if (frameCount <= PROFILER_OVERLAY_FRAMES)
+            return;
+
+        const u64 from = frames[(frameCount - 1 - PROFILER_OVERLAY_FRAMES) % PROFILER_FRAMES];
+        const u64 to   = frames[(frameCount - 1) % PROFILER_FRAMES];
+
+        const f32 rowHeight = 14, labelWidth = 90;
+        Rectangle timeline{bounds.x + labelWidth,
+                           bounds.y + 30,
+                           bounds.width - labelWidth - 10,
+                           bounds.height * 0.6f - 30};
+        const f64 scale = timeline.width / (f64)(to - from);
+
+        GuiPanel(bounds, std::format("Profiler: {:.2f}ms per frame",
+                                     Milliseconds(to - from) / PROFILER_OVERLAY_FRAMES)
+                             .c_str());
+
+        for (u32 f = 0; f <= PROFILER_OVERLAY_FRAMES; f++) {
+            const u64 mark = frames[(frameCount - 1 - f) % PROFILER_FRAMES];
+            const f32 x    = timeline.x + (f32)((mark - from) * scale);
+            DrawLine(x, timeline.y, x, timeline.y + timeline.height, GRAY);
+        }
+
+        struct Stats {
+            u64 count = 0, min = UINT64_MAX, max = 0, total = 0;
+        };
+        std::map<std::string_view, Stats> stats;
+        std::string                       hovered;
+
+        std::vector<ProfileRing*> threads;
+        {
+            std::lock_guard guard{lock};
+            threads = rings;
+        }
+
+        f32 laneY = timeline.y;
+        for (ProfileRing* ring : threads) {
+            u32 depth = 0;
+            ring->ForEach(from, [&](const ProfileEvent& event) {
+                if (event.start > to)
+                    return;
+
+                const u64 duration = event.end - event.start;
+                Stats&    zone     = stats[event.name];
+                zone.count++;
+                zone.total += duration;
+                zone.min = std::min(zone.min, duration);
+                zone.max = std::max(zone.max, duration);
+
+                const f32 y = laneY + event.depth * rowHeight;
+                if (y + rowHeight > timeline.y + timeline.height)
+                    return;
+
+                depth = std::max(depth, event.depth + 1);
+                const f64 start = std::max(event.start, from) - from;
+                const f64 end   = std::min(event.end, to) - from;
+                Rectangle bar{timeline.x + (f32)(start * scale),
+                              y,
+                              std::max((f32)((end - start) * scale), 1.0f),
+                              rowHeight - 1};
+
+                DrawRectangleRec(bar, colorOf(event.name));
+                if (bar.width > MeasureText(event.name, 10) + 4)
+                    DrawText(event.name, bar.x + 2, bar.y + 2, 10, BLACK);
+                if (CheckCollisionPointRec(GetMousePosition(), bar))
+                    hovered = std::format("{} {:.3f}ms", event.name, Milliseconds(duration));
+            });
+
+            if (depth > 0) {
+                DrawText(ring->name.c_str(), bounds.x + 8, laneY + 2, 10, DARKGRAY);
+                laneY += depth * rowHeight + 4;
+            }
+        }
+
+        // Default font isn't monospaced, so columns are placed one by one.
+        const char* headers[5] = {"Zone", "Calls", "Min ms", "Avg ms", "Max ms"};
+        const f32   columns[5] = {18, 160, 220, 280, 340};
+
+        f32 y = timeline.y + timeline.height + 8;
+        for (u32 c = 0; c < 5; c++) DrawText(headers[c], bounds.x + columns[c], y, 10, DARKGRAY);
+
+        for (auto& [name, zone] : stats) {
+            y += 12;
+            if (y + 12 > bounds.y + bounds.height)
+                break;
+
+            std::string cells[5] = {std::string(name),
+                                    std::format("{}", zone.count),
+                                    std::format("{:.3f}", Milliseconds(zone.min)),
+                                    std::format("{:.3f}", Milliseconds(zone.total) / zone.count),
+                                    std::format("{:.3f}", Milliseconds(zone.max))};
+            DrawRectangle(bounds.x + 8, y + 2, 6, 6, colorOf(name.data()));
+            for (u32 c = 0; c < 5; c++)
+                DrawText(cells[c].c_str(), bounds.x + columns[c], y, 10, BLACK);
+        }
+
+        if (!hovered.empty()) {
+            v2 mouse = GetMousePosition();
+            DrawRectangle(mouse.x + 12, mouse.y, MeasureText(hovered.c_str(), 10) + 8, 16, WHITE);
+            DrawText(hovered.c_str(), mouse.x + 16, mouse.y + 3, 10, BLACK);
+        }
+    }
+
+    // Allocations per frame over the MemoryTelemetry history, every arena's counters, with the
+    // arenas Arrays make for themselves summed into one row, and the busiest callsites.
+    static void DrawMemoryOverlay(Rectangle bounds) {
+        const FrameMemory last = MemoryTelemetry::Frame();
+        GuiPanel(bounds,
+                 std::format("Memory: {} heap allocations ({} B), {} arena ({} B) last frame",
+                             last.heapAllocations,
+                             last.heapBytes,
+                             last.arenaAllocations,
+                             last.arenaBytes)
+                     .c_str());
+
+        // Heap allocations per frame, newest on the right, scaled to the busiest frame.
+        Rectangle graph{bounds.x + 8, bounds.y + 30, bounds.width - 16, 60};
+        u64       busiest = 1;
+        for (u64 ago = 0; ago < MEMORY_HISTORY; ago++)
+            busiest = std::max(busiest, MemoryTelemetry::Frame(ago).heapAllocations);
+
+        const f32 barWidth = graph.width / MEMORY_HISTORY;
+        for (u64 ago = 0; ago < MEMORY_HISTORY; ago++) {
+            const f32 height = graph.height * MemoryTelemetry::Frame(ago).heapAllocations / busiest;
+            DrawRectangleRec(Rectangle{graph.x + graph.width - (ago + 1) * barWidth,
+                                       graph.y + graph.height - height,
+                                       std::max(barWidth - 1, 1.0f),
+                                       height},
+                             ago == 0 ? RED : GRAY);
+        }
+        DrawText(std::format("{} max, heap {} B live, {} B peak",
+                             busiest,
+                             MemoryTelemetry::heapLive.load(),
+                             MemoryTelemetry::heapPeak.load())
+                     .c_str(),
+                 graph.x,
+                 graph.y + graph.height + 4,
+                 10,
+                 DARKGRAY);
+
+        const char* headers[6] = {
+            "Arena", "Size", "High water", "Allocations", "Wraps", "Overflows"};
+        const f32   columns[6] = {8, 160, 230, 310, 390, 440};
+
+        f32 y = graph.y + graph.height + 22;
+        for (u32 c = 0; c < 6; c++) DrawText(headers[c], bounds.x + columns[c], y, 10, DARKGRAY);
+
+        auto row = [&](const std::string& name, usize size, usize high, u64 count, u64 wraps,
+                       u64 overflows) {
+            y += 12;
+            if (y + 12 > bounds.y + bounds.height)
+                return;
+
+            std::string cells[6] = {name,
+                                    std::format("{}", size),
+                                    std::format("{}", high),
+                                    std::format("{}", count),
+                                    std::format("{}", wraps),
+                                    std::format("{}", overflows)};
+            for (u32 c = 0; c < 6; c++)
+                DrawText(cells[c].c_str(),
+                         bounds.x + columns[c],
+                         y,
+                         10,
+                         c >= 4 && cells[c] != "0" ? RED : BLACK);
+        };
+
+        MemoryTelemetry::ForEachArena([&](const Arena& arena) {
+            row(arena.name,
+                arena.size,
+                arena.highWater.load(std::memory_order_relaxed),
+                arena.allocations.load(std::memory_order_relaxed),
+                arena.wraps.load(std::memory_order_relaxed),
+                arena.overflows.load(std::memory_order_relaxed));
+        });
+        // Each of these is allocated whole, once.
+        const u64 arrayBytes = MemoryTelemetry::arrayBytes.load(std::memory_order_relaxed);
+        const u64 arrays     = MemoryTelemetry::arrayArenas.load(std::memory_order_relaxed);
+        row(std::format("Arrays ({}, leaked)", arrays), arrayBytes, arrayBytes, arrays, 0, 0);
+
+#if defined(MEMORY_TELEMETRY)
+        y += 18;
+        DrawText("Callsite", bounds.x + columns[0], y, 10, DARKGRAY);
+        DrawText("Bytes", bounds.x + columns[2], y, 10, DARKGRAY);
+        DrawText("Allocations", bounds.x + columns[3], y, 10, DARKGRAY);
+        for (const AllocationSite& site : MemoryTelemetry::Sites()) {
+            y += 12;
+            if (y + 12 > bounds.y + bounds.height)
+                break;
+
+            std::string where =
+                std::format("{}:{}", fs::path(site.file).filename().string(), site.line);
+            DrawText(where.c_str(), bounds.x + columns[0], y, 10, BLACK);
+            DrawText(std::format("{}", site.bytes).c_str(), bounds.x + columns[2], y, 10, BLACK);
+            DrawText(
+                std::format("{}", site.allocations).c_str(), bounds.x + columns[3], y, 10, BLACK);
+        }
+#endif
+    }
+
+    // Writes every zone still in the rings in Chrome's trace event format. Main thread only.
+    static bool ExportChromeTrace(const std::string& path = PROFILER_TRACE_PATH) {
+        std::ofstream outFile(path);
+        if (!outFile) {
+            std::cout << "ERROR: ENGINE: Error opening file for writing: " << path << "\n";
+            return false;
+        }
+
+        const f64 microseconds = nanosecondsPerTick() / 1000;
+
+        std::vector<ProfileRing*> threads;
+        {
+            std::lock_guard guard{lock};
+            threads = rings;
+        }
+
+        usize zones = 0;
+        outFile << "{\"traceEvents\":[";
+        for (ProfileRing* ring : threads) {
+            outFile << std::format("{}\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                                   "\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                                   ring == threads.front() ? "" : ",",
+                                   ring->id,
+                                   escape(ring->name));
+
+            ring->ForEach(originTicks, [&](const ProfileEvent& event) {
+                outFile << std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},"
+                                       "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                                       escape(event.name),
+                                       ring->id,
+                                       (event.start - originTicks) * microseconds,
+                                       (event.end - event.start) * microseconds);
+                zones++;
+            });
+        }
+        outFile << "\n]}\n";
+
+        std::cout << "INFO: ENGINE: Wrote " << zones << " profiler zones to " << path << "\n";
+        return true;
+    }
+};
+
+// Times its scope as a zone named by the string literal it's given.
+class ProfileZone {
+    const char*  name;
+    ProfileRing& ring;
+    u64          start;
+
+   public:
+    explicit ProfileZone(const char* _name)
+        : name{_name}, ring{Profiler::Ring()}, start{Profiler::Now()} {
+        ring.depth++;
+    }
+
+    ProfileZone(const ProfileZone&)            = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    ~ProfileZone() {
+        const u64 end = Profiler::Now();
+        ring.depth--;
+        ring.Record(ProfileEvent{name, start, end, ring.depth});
+    }
+};
+
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profileZone, line)
+
+// Defining PROFILER_DISABLED compiles zones out.
+#if defined(PROFILER_DISABLED)
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_NAME(__LINE__){name}
+#endif
@@ -1,9 +1,9 @@
 #pragma once
-#include <intrin.h>
 
-#include <random>
+#include "automata.hpp"
+#include "points.hpp"
 
-#include "engine.hpp"
+#define EXTREME_EDGES_POINTS 200  // Points ConvexHullTesting ticks run extreme edges on
 
 static Array<u64> gs_data(2000);
 static Array<u64> jm_data(2000);
@@ -12,6 +12,7 @@ static Array<u64> ee_data(2000);
 struct RayTesting : public Scene {
     Array<Shape2D> colliders{
         Rectangle{100, 100, 50, 50}, Rectangle{400, 300, 100, 50}, Rectangle{500, 50, 50, 100}};
+    DebugDraw debug;
 
     void DrawUI() final {
         for (usize i = 0; i < colliders.count; i++) {
@@ -20,14 +21,15 @@ struct RayTesting : public Scene {
 
         v2 emitter = GetMousePosition();
         for (f32 i = 0; i < PI * 2 - .01; i += PI / 32) {
-            v2        end{150 * cos(i) + emitter.x, 150 * sin(i) + emitter.y};
+            v2        end{150 * std::cos(i) + emitter.x, 150 * std::sin(i) + emitter.y};
             Collision collision = CastRay(emitter, end, colliders);
 
-            DrawLineV(emitter, collision.hit ? collision.point : end, GREEN);
+            debug.Line(emitter, collision.hit ? collision.point : end, GREEN);
             if (collision.hit)
-                DrawCircleV(collision.point, 5, RED);
+                debug.Point(collision.point, 5, RED);
         }
-        DrawCircleV(emitter, 10, BLUE);
+        debug.Point(emitter, 10, BLUE);
+        debug.Flush();
 
         DrawFPS(10, 50);
     }
@@ -36,42 +38,67 @@ struct RayTesting : public Scene {
 struct ConvexHullTesting : public Scene {
    private:
     const usize NUM = 2000;  // TODO CHANGE
+    Arena       pointsArena{NUM * sizeof(v2) + alignof(v2), "Test points"};
+    Arena       hullArena{2 * (NUM * sizeof(Edge) + alignof(Edge)), "Test hulls"};
+    PointCloud  cloud{PointDistribution::Uniform,
+                     Rectangle{screenWidth / 5.0f,
+                               screenHeight / 5.0f,
+                               screenWidth / 2.0f,
+                               screenHeight / 2.0f}};
     Array<v2>   test_points;
     Array<Edge> extremes;
     ItemGrabber grabber;
+    DebugDraw   debug;
+    bool        regenerate = false;
 
-    Array<v2> generatePoints(const usize count) {
-        static Array<v2> points(count);
-        points.Clear();
-
-        std::random_device                    rd;         // Obtain a random number from hardware
-        std::mt19937                          eng(rd());  // Seed the generator
-        std::uniform_real_distribution<float> distr(0.0, 1.0);  // Define the range
+    // What gets drawn, copied out of the arenas the hull is computed in. Ticks fill the back
+    // frame on the simulation worker and Publish() swaps it to the front.
+    struct Frame {
+        std::vector<v2>   points;
+        std::vector<Edge> hull;
+        Circle            disk;
+    };
+    Frame front, back;
+    bool  computed = false;
 
-        for (usize i = 0; i < count; ++i) {
-            points.Push(v2{distr(eng) * screenWidth / 2 + screenWidth / 5,
-                           distr(eng) * screenHeight / 2 + screenHeight / 5});
-        }
+    void capture(Frame& frame) {
+        frame.points.assign(test_points.buffer, test_points.buffer + test_points.count);
+        frame.hull.assign(extremes.buffer, extremes.buffer + extremes.count);
+        frame.disk = EnclosingDisk(test_points);
+    }
 
-        return points;
+    // New points each time, reproducible from POINTS_DEFAULT_SEED. Only the latest set is kept.
+    Array<v2> generatePoints(const usize count) {
+        pointsArena.Clear();
+        cloud.seed++;
+        return GeneratePoints(cloud, count, pointsArena);
     }
 
-    void drawPoints(const Array<v2>& points) {
-        for (usize i = 0; i < points.count; ++i) {
-            DrawCircle(points[i].x, points[i].y, 5, BLACK);
+    void drawPoints(const std::vector<v2>& points, const Circle& welzl) {
+        for (usize i = 0; i < points.size(); ++i) {
+            debug.Point(points[i], 5, BLACK);
+            debug.Text(points[i] + v2{5, 5},
+                       10,
+                       BLACK,
+                       "{:.0f}, {:.0f} [{}]",
+                       points[i].x,
+                       points[i].y,
+                       i);
+        }
 
-            std::string display = std::format("{:.0f}, {:.0f} [{}]", points[i].x, points[i].y, i);
-            DrawText(display.c_str(), points[i].x + 5, points[i].y + 5, 10, BLACK);
+        debug.CircleOutline(v2{welzl.x, welzl.y}, welzl.r, BLUE);
+    }
 
-            Circle welzl = EnclosingDisk(points);
-            DrawCircleLines(welzl.x, welzl.y, welzl.r, BLUE);
+    void drawEdges(const std::vector<Edge>& extremes) {
+        for (const Edge& edge : extremes) {
+            debug.Line(edge.p, edge.q, BLUE);
         }
     }
 
-    void drawEdges(const Array<Edge>& extremes) {
-        for (usize i = 0; i < extremes.count; i++) {
-            DrawLine(extremes[i].p.x, extremes[i].p.y, extremes[i].q.x, extremes[i].q.y, BLUE);
-        }
+    // Ticks go on for longer than the timings have room for, so later ones are dropped.
+    static void record(Array<u64>& data, u64 cycles) {
+        if (data.count < data.size)
+            data.Push(cycles);
     }
 
     void perPointsTest() {
@@ -83,13 +110,14 @@ struct ConvexHullTesting : public Scene {
             st              = __rdtsc() - st;
             gs_data.Push(st);
 
+            hullArena.Clear();
             st = __rdtsc();
-            ConvexHull_JarvisMarch(inc_points);
+            ConvexHull_JarvisMarch(inc_points, hullArena);
             st = __rdtsc() - st;
             jm_data.Push(st);
 
             st = __rdtsc();
-            ConvexHull_ExtremeEdges(inc_points);
+            ConvexHull_ExtremeEdges(inc_points, hullArena);
             st = __rdtsc() - st;
             ee_data.Push(st);
         }
@@ -99,35 +127,73 @@ struct ConvexHullTesting : public Scene {
     ConvexHullTesting()
         : test_points{generatePoints(NUM)},
           extremes{ConvexHull_GrahamScan(test_points)},
-          grabber{ItemGrabber(&test_points)} {}
+          grabber{ItemGrabber(&test_points)} {
+        pipelined = true;
+        capture(front);
+    }
+
+    void Publish() final {
+        if (computed)
+            std::swap(front, back);
+        computed = false;
+    }
+
+    void Input() final {
+        if (regenerate)
+            test_points = generatePoints(NUM);
+        regenerate = false;
+    }
 
     void Compute() final {
         // grabber();
+        hullArena.Clear();
 
-        u64 st   = __rdtsc();
-        extremes = ConvexHull_GrahamScan(test_points);
-        st       = __rdtsc() - st;
-        gs_data.Push(st);
+        {
+            PROFILE_ZONE("Graham scan");
+            u64 st   = __rdtsc();
+            extremes = ConvexHull_GrahamScan(test_points);
+            st       = __rdtsc() - st;
+            record(gs_data, st);
+        }
+        {
+            PROFILE_ZONE("Jarvis march");
+            u64 st = __rdtsc();
+            ConvexHull_JarvisMarch(test_points, hullArena);
+            st = __rdtsc() - st;
+            record(jm_data, st);
+        }
+        {
+            // Cubic: on every point, one tick takes seconds.
+            Array<v2> subset = test_points;
+            subset.count     = std::min<usize>(subset.count, EXTREME_EDGES_POINTS);
 
-        st = __rdtsc();
-        ConvexHull_JarvisMarch(test_points);
-        st = __rdtsc() - st;
-        jm_data.Push(st);
+            PROFILE_ZONE("Extreme edges");
+            u64 st = __rdtsc();
+            ConvexHull_ExtremeEdges(subset, hullArena);
+            st = __rdtsc() - st;
+            record(ee_data, st);
+        }
 
-        st = __rdtsc();
-        ConvexHull_ExtremeEdges(test_points);
-        st = __rdtsc() - st;
-        ee_data.Push(st);
+        PROFILE_ZONE("Capture frame");
+        capture(back);
+        computed = true;
     }
 
     void Draw2D() final {}
 
     void DrawUI() final {
-        drawPoints(test_points);
-        drawEdges(extremes);
+        drawPoints(front.points, front.disk);
+        drawEdges(front.hull);
+        debug.Flush();
 
         if (GuiButton(Rectangle{10, 50, 100, 30}, "New points")) {
-            test_points = generatePoints(NUM);
+            regenerate = true;
+        }
+        if (GuiButton(Rectangle{120, 50, 100, 30},
+                      PointDistributionNames[(usize)cloud.distribution])) {
+            const usize next   = ((usize)cloud.distribution + 1) % (usize)PointDistribution::Count;
+            cloud.distribution = (PointDistribution)next;
+            regenerate = true;
         }
 
         DrawFPS(10, 100);
@@ -135,15 +201,253 @@ struct ConvexHullTesting : public Scene {
 
     void RunTest1() {
         perPointsTest();
-        SaveAsCsv("benchmarks/convexhull_02.csv",
+        SaveAsCsv("../benchmarks/convexhull_02.csv",
                   {gs_data, jm_data, ee_data},
                   "Graham Scan,Jarvis March,Extreme Edges");
         abort();
     }
 
     void RunTest2() {
-        SaveAsCsv("benchmarks/convexhull_01.csv",
+        SaveAsCsv("../benchmarks/convexhull_01.csv",
                   {gs_data, jm_data, ee_data},
                   "Graham Scan,Jarvis March,Extreme Edges");
     }
-};
\ No newline at end of file
+};
+
+struct AutomataTesting : public Scene {
+    GenerationsBoard board{1024, 1024, AutomatonRule::Parse("B2/S/C3")};
+
+    AutomataTesting() { board.Randomize(0.3f); }
+
+    void Compute() final { board.Update(); }
+
+    void DrawUI() final {
+        f32 side = (f32)std::min(screenWidth, screenHeight) - 160;
+        board.Draw(Rectangle{150, 80, side, side});
+
+        std::string display =
+            std::format("Generation {}, population {}", board.generation, board.Population());
+        DrawText(display.c_str(), 10, 130, 10, BLACK);
+        DrawFPS(10, 100);
+    }
+
+    // Prints cell updates per second stepping a random board: nominal, as if every cell of the
+    // board was recomputed every generation, and of the cells in the tiles actually recomputed.
+    static void RunBenchmark(u32         size        = 4096,
+                             u32         generations = 200,
+                             const char* rule        = "B3/S23",
+                             u32         threads     = std::thread::hardware_concurrency()) {
+        ConwayBoard bench(size, size, AutomatonRule::Parse(rule));
+        bench.Randomize(0.3f, 42);
+
+        auto start = ch::steady_clock::now();
+        bench.Update(generations, threads);
+        f64 seconds = ch::duration<f64>(ch::steady_clock::now() - start).count();
+
+        const f64 nominal = (f64)size * size * generations;
+        const f64 stepped = (f64)bench.cellsStepped.load();
+        std::cout << std::format("INFO: BENCH: {} {}x{}, {} generations, {} threads: {:.3f}s, "
+                                 "{:.3e} cells/s nominal, {:.3e} cells/s stepped ({:.1f}% of "
+                                 "cells in active tiles)\n",
+                                 rule,
+                                 size,
+                                 size,
+                                 generations,
+                                 threads,
+                                 seconds,
+                                 nominal / seconds,
+                                 stepped / seconds,
+                                 100 * stepped / nominal);
+    }
+};
+
+// Checks ParallelMax, ParallelMin and ParallelMaxGap against the serial Array versions on random
+// arrays, with a small grain so even short ones are split into several chunks. The serial MaxGap
+// rounds its bucket width, so values span a multiple of count - 1 where it is exact. Prints every
+// mismatch and returns whether there were none.
+static bool CheckParallelReductions(u64 seed = 42) {
+    Xoshiro256 rng(seed);
+    bool       passed = true;
+    for (usize count : {2, 3, 17, 1000, 100003}) {
+        const i32  range = (i32)(count - 1) * 1000;
+        Array<i32> values(count);
+        values.Push(0);
+        values.Push(range);
+        while (values.count < count) values.Push((i32)(rng() % (range + 1)));
+        std::shuffle(values.buffer, values.buffer + count, rng);
+
+        const auto check = [&](const char* name, i32 parallel, i32 serial) {
+            if (parallel == serial)
+                return;
+            std::cout << std::format("ERROR: ENGINE: {} of {} values is {}, serial gives {}\n",
+                                     name,
+                                     count,
+                                     parallel,
+                                     serial);
+            passed = false;
+        };
+        check("ParallelMax", ParallelMax(values, 8), values.Max());
+        check("ParallelMin", ParallelMin(values, 8), values.Min());
+        check("ParallelMaxGap", ParallelMaxGap(values, 8), values.MaxGap());
+    }
+    return passed;
+}
+
+// Checks that SaveAsCsv keeps rows together across blocks: two columns longer than
+// COLUMN_BLOCK_ROWS, then a long one beside a short one that leaves its cells empty.
+static bool CheckColumnWriter() {
+    const std::string path   = (fs::temp_directory_path() / "enginetest_columns.csv").string();
+    const usize       rows   = COLUMN_BLOCK_ROWS + 4464;
+    bool              passed = true;
+
+    Array<u64> first(rows), second(rows), shorter(100);
+    for (usize i = 0; i < rows; i++) {
+        first.Push(i);
+        second.Push(2 * i);
+    }
+    for (usize i = 0; i < shorter.size; i++) shorter.Push(3 * i);
+
+    for (const Array<u64>& other : {second, shorter}) {
+        SaveAsCsv(path, {first, other}, "First,Other");
+
+        std::ifstream file(path);
+        std::string   line;
+        usize         lines = 0;
+        while (std::getline(file, line)) {
+            std::string expected = "First,Other";
+            if (lines > 0 && lines <= rows) {
+                const usize row = lines - 1;
+                expected        = std::format("{},", first[row]);
+                if (row < other.count)
+                    expected += std::to_string(other[row]);
+            }
+
+            if (line != expected && passed) {
+                std::cout << std::format("ERROR: ENGINE: Line {} of {} is {}, expected {}\n",
+                                         lines + 1,
+                                         path,
+                                         line,
+                                         expected);
+                passed = false;
+            }
+            lines++;
+        }
+
+        if (lines != rows + 1) {
+            std::cout << std::format("ERROR: ENGINE: {} has {} lines, expected {}\n",
+                                     path,
+                                     lines,
+                                     rows + 1);
+            passed = false;
+        }
+    }
+
+    std::error_code error;
+    fs::remove(path, error);
+    return passed;
+}
+
+// One cloud through every hull. GrahamScan and JarvisMarch must be closed (there and back if all
+// the points are in line), every hull must have every point on the same side of each edge, and all
+// three must share their corners. The enclosing disk must hold every point.
+template <Point2D P>
+static bool CheckHulls(Array<P>& points, Arena& hulls) {
+    using Traits = TraitsOf<P>;
+
+    const auto valid = [&points](const Array<EdgeT<P>>& hull, bool closed) {
+        if (hull.count < 2 ||
+            (closed && memcmp(&hull[hull.count - 1].q, &hull[0].p, sizeof(P)) != 0))
+            return false;
+        for (usize e = 0; e < hull.count; e++) {
+            bool left = false, right = false;
+            for (usize i = 0; i < points.count; i++) {
+                const auto cross = vec2::Cross(points[i], hull[e].p, hull[e].q);
+                left             = left || cross > 0;
+                right            = right || cross < 0;
+            }
+            if (left && right)
+                return false;
+        }
+        return true;
+    };
+    const auto corners = [](const Array<EdgeT<P>>& hull) {
+        std::vector<std::pair<ScalarOf<P>, ScalarOf<P>>> result;
+        for (usize e = 0; e < hull.count; e++) result.push_back({hull[e].p.x, hull[e].p.y});
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    const auto disk = EnclosingDisk(points);
+    bool       held = std::isfinite(disk.r);
+    for (usize i = 0; i < points.count; i++)
+        held = held && std::hypot(Traits::ToReal(points[i].x) - disk.x,
+                                  Traits::ToReal(points[i].y) - disk.y) <= disk.r * 1.0001 + 0.0001;
+
+    hulls.Clear();
+    const Array<EdgeT<P>> extreme = ConvexHull_ExtremeEdges(points, hulls);
+    const Array<EdgeT<P>> jarvis  = ConvexHull_JarvisMarch(points, hulls);
+    const Array<EdgeT<P>> graham  = ConvexHull_GrahamScan(points);
+    return held && valid(extreme, false) && valid(jarvis, true) && valid(graham, true) &&
+           corners(jarvis) == corners(graham) && corners(extreme) == corners(graham);
+}
+
+// CheckHulls on 2000 small clouds of an 8x8 grid, full of points in line. Returns the failures.
+template <Point2D P>
+static u32 CheckGridHulls(u64 seed, Arena& arena, Arena& hulls) {
+    using Scalar = ScalarOf<P>;
+
+    Xoshiro256 rng(seed);
+    u32        failures = 0;
+    for (u32 cloud = 0; cloud < 2000; cloud++) {
+        arena.Clear();
+        Array<P>    points(64, &arena);
+        bool        taken[64] = {};
+        const usize count     = 3 + rng() % 20;
+        while (points.count < count) {
+            const u32 cell = rng() % 64;
+            if (!taken[cell])
+                points.Push(P{Scalar(cell % 8), Scalar(cell / 8)});
+            taken[cell] = true;
+        }
+        failures += !CheckHulls(points, hulls);
+    }
+    return failures;
+}
+
+// Checks the hulls on grid clouds in every coordinate type: float, double, integer and fixed
+// point. Then on Circle and Collinear clouds, where every point or many in line are on the hull.
+static bool CheckConvexHulls(u64 seed = 42) {
+    Arena arena(DEFAULT_ARENA_SIZE, "Hull check points");
+    Arena hulls(DEFAULT_ARENA_SIZE, "Hull check edges");
+    bool  passed = true;
+
+    const auto report = [&](const char* clouds, u32 failures, u32 count) {
+        if (!failures)
+            return;
+        std::cout << "ERROR: ENGINE: Convex hulls wrong for " << failures << " of " << count
+                  << " " << clouds << " clouds\n";
+        passed = false;
+    };
+
+    // A corner in line with the scan's first point, which it once dropped.
+    Array<v2> example({{0, 4}, {1, 0}, {2, 1}, {1, 1}, {0, 6}, {5, 6}, {3, 7}, {0, 5}}, &arena);
+    report("example", !CheckHulls(example, hulls), 1);
+
+    report("v2 grid", CheckGridHulls<v2>(seed, arena, hulls), 2000);
+    report("v2d grid", CheckGridHulls<v2d>(seed, arena, hulls), 2000);
+    report("v2i grid", CheckGridHulls<v2i>(seed, arena, hulls), 2000);
+    report("v2fx grid", CheckGridHulls<v2fx>(seed, arena, hulls), 2000);
+
+    for (auto distribution : {PointDistribution::Circle, PointDistribution::Collinear}) {
+        u32 failures = 0;
+        for (u32 cloud = 0; cloud < 20; cloud++) {
+            arena.Clear();
+            Array<v2> points = GeneratePoints(
+                PointCloud{distribution, Rectangle{0, 0, 512, 512}, seed + cloud}, 200, arena);
+            failures += !CheckHulls(points, hulls);
+        }
+        report(PointDistributionNames[(usize)distribution], failures, 20);
+    }
+
+    return passed;
+}
@@ -1,14 +1,12 @@
 #pragma once
 #include <random>
 
-#include "engine.hpp"
+#include "tilemap.hpp"
 
-enum TileRotation { UP = 0, RIGHT = 1, DOWN = 2, LEFT = 3 };
+#define EDITOR_STATUS_COLUMNS 48  // Cells in the editor's status line
 
+// Draws the map through Scene::camera, whose offset puts tile (0, 0) at the editor window's corner.
 class TileEditor : public Scene {
-   public:
-    PixelCamera2D camera;
-
    private:
     // GUI
     void ExportBtn(){};
@@ -58,146 +56,370 @@ class TileEditor : public Scene {
 
     // -----
 
-    Texture tileset;
-    f32     tileSize;
-    u32     tilesetSize;
+    AssetManager  &assets;
+    const Tileset &tileset;
+    f32            tileSize;
+    bool           tilesetApplied = false;
+
+    struct ImportedMap {
+        bool             ok = false;
+        v2u              size{};
+        std::vector<u32> ids;
+    };
+    Asset<ImportedMap> pendingImport;
+    std::string        importName;
 
     i32          selected         = 0;
     TileRotation selectedRotation = UP;
-
-    Array<u32>          tilemap;
-    Array<TileRotation> tileRotation;
+    bool         showGrid         = false;
+    bool         strokeOpen       = false;  // Between a press in the editor and its release
+    v2i          dragStart{};               // Tile the open stroke started on
+
+    v2u             mapSize;
+    TileChunkStore  tiles;
+    TileJournal     journal;
+    TilemapRenderer renderer;
+    GridRenderer    grid;
+
+    CharGrid    status{EDITOR_STATUS_COLUMNS, 1};  // In the tileset's own glyphs
+    u16         asciiTiles[128]{};                 // First tile showing each ASCII character
+    std::string statusText;
+
+    // Map file being edited. Chunks are read from it as they're first drawn or edited.
+    MappedTilemap mapFile;
+
+    void resizeMap(v2u size) {
+        mapSize = size;
+        renderer.Resize(size);
+    }
 
     void drawTile(u32 idx, v2 position, TileRotation rotation = UP) {
-        v2 origin{};
-        switch (rotation) {
-            case UP:
-                origin = {0, 0};
-                break;
-
-            case RIGHT:
-                origin = {0, tileSize};
-                break;
-
-            case DOWN:
-                origin = {tileSize, tileSize};
-                break;
-
-            case LEFT:
-                origin = {tileSize, 0};
-                break;
-
-            default:
-                break;
+        tileset.Draw(idx, rotation, Rectangle{position.x, position.y, tileSize, tileSize});
+    }
+
+    void drawGrid() { grid.Draw(camera, tileSize, mapSize); }
+
+    void drawSelected() {
+        if (!vec2::IsInRectangle(GetMousePosition(), layoutRecs[EDITOR]))
+            return;
+
+        v2i tile = mouseTile();
+        drawTile(selected,
+                 GetWorldToScreen2D(v2{tile.x * tileSize, tile.y * tileSize}, camera),
+                 selectedRotation);
+    }
+
+    // Cursor tile and brush under the editor window. The line is only rewritten, and so only
+    // uploaded, when its text changes.
+    void drawStatus() {
+        char      text[EDITOR_STATUS_COLUMNS + 1];
+        const v2i tile = mouseTile();
+        if (inMap(tile) && vec2::IsInRectangle(GetMousePosition(), layoutRecs[EDITOR]))
+            snprintf(text, sizeof(text), "X %-4d Y %-4d ", tile.x, tile.y);
+        else
+            text[0] = '\0';
+        const usize length = strlen(text);
+        snprintf(text + length,
+                 sizeof(text) - length,
+                 "TILE %-5d %3d DEG",
+                 selected,
+                 (i32)selectedRotation * 90);
+
+        if (statusText != text) {
+            statusText = text;
+            for (u32 x = 0; x < status.width; x++) {
+                const u8 c = x < statusText.size() ? statusText[x] : ' ';
+                status.Set(x, 0, asciiTiles[c < 128 ? c : ' '], GRAY, BLANK);
+            }
         }
 
-        DrawTexturePro(tileset,
-                       Rectangle{(f32)tileSize * (idx % tilesetSize),
-                                 (f32)tileSize * (idx / tilesetSize),
-                                 tileSize,
-                                 tileSize},
-                       Rectangle{position.x, position.y, (f32)tileSize, (f32)tileSize},
-                       origin,
-                       rotation * 90,
-                       WHITE);
+        const Rectangle area = layoutRecs[EDITOR];
+        status.Draw(
+            Rectangle{area.x, area.y + area.height + 4, status.width * tileSize, tileSize});
+    }
+
+    void drawMap() {
+        renderer.Draw(camera, [this](i32 x, i32 y) { return tiles.Get(v2i{x, y}); });
+    }
+
+    v2i mouseTile() {
+        v2 mousePosInCanvas = GetScreenToWorld2D(GetMousePosition(), camera);
+        return v2i{(i32)floorf(mousePosInCanvas.x / tileSize),
+                   (i32)floorf(mousePosInCanvas.y / tileSize)};
+    }
+
+    bool inMap(v2i tile) const {
+        return tile.x >= 0 && tile.y >= 0 && tile.x < (i32)mapSize.x && tile.y < (i32)mapSize.y;
+    }
+
+    void placeTile() {
+        v2i tile = mouseTile();
+        if (!inMap(tile))
+            return;
+
+        journal.Begin();
+        setTile(tile, selected, selectedRotation);
+        journal.End();
+    }
+
+    // Every edit goes through here or writeRow(), inside a journal command.
+    void setTile(v2i tile, u32 id, TileRotation rotation) {
+        auto [oldId, oldRotation] = tiles.Get(tile);
+        if (oldId == id && oldRotation == rotation)
+            return;
+
+        journal.Record(tile, oldId, oldRotation, id, rotation);
+        tiles.Set(tile, id, rotation);
+        renderer.MarkDirty(tile);
+    }
+
+    // Bulk edits write whole rows at once, clipped to the map.
+    std::vector<u32> rowIds, oldIds;
+    std::vector<u8>  rowRotations, oldRotations;
+
+    void writeRow(v2i start, u32 length, const u32 *ids, const u8 *rotations) {
+        i32 from = std::max(start.x, 0);
+        i32 to   = std::min(start.x + (i32)length, (i32)mapSize.x);
+        if (start.y < 0 || start.y >= (i32)mapSize.y || from >= to)
+            return;
+
+        ids += from - start.x;
+        rotations += from - start.x;
+        start  = v2i{from, start.y};
+        length = to - from;
+
+        oldIds.resize(length);
+        oldRotations.resize(length);
+        tiles.ReadRow(start, length, oldIds.data(), oldRotations.data());
+        journal.RecordRow(start, length, oldIds.data(), oldRotations.data(), ids, rotations);
+        tiles.WriteRow(start, length, ids, rotations);
+        renderer.MarkDirty(start, v2i{to - 1, start.y});
     }
 
-    void drawGrid() {
-        static f32 thickness = 0.1f;
+    void fillRow(v2i start, u32 length, u32 id, TileRotation rotation) {
+        rowIds.assign(length, id);
+        rowRotations.assign(length, (u8)rotation);
+        writeRow(start, length, rowIds.data(), rowRotations.data());
+    }
+
+    void fillRect(v2i a, v2i b, u32 id, TileRotation rotation) {
+        journal.Begin();
+        for (i32 y = std::min(a.y, b.y); y <= std::max(a.y, b.y); y++)
+            fillRow(v2i{std::min(a.x, b.x), y}, std::abs(b.x - a.x) + 1, id, rotation);
+        journal.End();
+    }
 
-        for (f32 i = 0; i < screenWidth && (i / tileSize) < tilemap.size; i += tileSize) {
-            DrawLineEx(v2{i, 0}, v2{i, f32(screenHeight)}, thickness, GRAY);
+    // Bresenham, with horizontal runs written as rows.
+    void fillLine(v2i a, v2i b, u32 id, TileRotation rotation) {
+        const i32 dx = std::abs(b.x - a.x), sx = a.x < b.x ? 1 : -1;
+        const i32 dy = -std::abs(b.y - a.y), sy = a.y < b.y ? 1 : -1;
+
+        journal.Begin();
+        v2i runStart = a, runEnd = a;
+        for (i32 error = dx + dy; a.x != b.x || a.y != b.y;) {
+            i32 twice = 2 * error;
+            if (twice >= dy) {
+                error += dy;
+                a.x += sx;
+            }
+            if (twice <= dx) {
+                error += dx;
+                a.y += sy;
+            }
+
+            if (a.y != runStart.y) {
+                fillRow(v2i{std::min(runStart.x, runEnd.x), runStart.y},
+                        std::abs(runEnd.x - runStart.x) + 1,
+                        id,
+                        rotation);
+                runStart = a;
+            }
+            runEnd = a;
         }
+        fillRow(v2i{std::min(runStart.x, runEnd.x), runStart.y},
+                std::abs(runEnd.x - runStart.x) + 1,
+                id,
+                rotation);
+        journal.End();
+    }
+
+    // Scanline fill of the tiles connected to seed that match it. Stops after maxTiles, so a
+    // click on an empty 100k x 100k map doesn't fill ten billion tiles.
+    void floodFill(v2i seed, u32 id, TileRotation rotation, usize maxTiles = 1 << 22) {
+        if (!inMap(seed))
+            return;
 
-        for (f32 i = 0; i < screenHeight && (i / tileSize) < tilemap.stride; i += tileSize) {
-            DrawLineEx(v2{0, i}, v2{f32(screenWidth), i}, thickness, GRAY);
+        const auto target = tiles.Get(seed);
+        if (target == std::pair{id, rotation})
+            return;
+
+        std::vector<v2i> stack{seed};
+        std::vector<u32> ids;  // The rows above and below a run, read a chunk at a time
+        std::vector<u8>  rotations;
+        usize            filled = 0;
+
+        journal.Begin();
+        while (!stack.empty() && filled < maxTiles) {
+            v2i tile = stack.back();
+            stack.pop_back();
+            if (tiles.Get(tile) != target)
+                continue;
+
+            const i32 left =
+                tile.x - (i32)tiles.CountRun(v2i{tile.x - 1, tile.y}, -1, tile.x, target);
+            const i32 right = tile.x + (i32)tiles.CountRun(v2i{tile.x + 1, tile.y},
+                                                           1,
+                                                           (i32)mapSize.x - 1 - tile.x,
+                                                           target);
+            const u32 length = right - left + 1;
+
+            fillRow(v2i{left, tile.y}, length, id, rotation);
+            filled += length;
+
+            // Seed the start of every matching run above and below.
+            ids.resize(length);
+            rotations.resize(length);
+            for (i32 y : {tile.y - 1, tile.y + 1}) {
+                if (y < 0 || y >= (i32)mapSize.y)
+                    continue;
+
+                tiles.ReadRow(v2i{left, y}, length, ids.data(), rotations.data());
+                bool previous = false;
+                for (u32 i = 0; i < length; i++) {
+                    const bool match = ids[i] == target.first && rotations[i] == target.second;
+                    if (match && !previous)
+                        stack.push_back(v2i{left + (i32)i, y});
+                    previous = match;
+                }
+            }
         }
+        journal.End();
+
+        if (filled >= maxTiles)
+            std::cout << "INFO: ENGINE: Flood fill stopped at " << filled << " tiles\n";
     }
 
-    void drawSelected() {
-        // v2 mousePosInCanvas = camera.Reproject(GetMousePosition());
-        v2 mousePos = GetMousePosition();
-        if (!vec2::IsInRectangle(mousePos, layoutRecs[EDITOR]))
+    TileStamp stamp;
+
+    void copyStamp(v2i a, v2i b) {
+        v2i from{std::max(std::min(a.x, b.x), 0), std::max(std::min(a.y, b.y), 0)};
+        v2i to{std::min(std::max(a.x, b.x), (i32)mapSize.x - 1),
+               std::min(std::max(a.y, b.y), (i32)mapSize.y - 1)};
+        if (from.x > to.x || from.y > to.y)
             return;
 
-        drawTile(selected,
-                 v2{(f32)((u32)mousePos.x - (u32)mousePos.x % (u32)tileSize),
-                    (f32)((u32)mousePos.y - (u32)mousePos.y % (u32)tileSize)},
-                 selectedRotation);
+        stamp.size = v2u{u32(to.x - from.x + 1), u32(to.y - from.y + 1)};
+        stamp.ids.resize(stamp.size.x * stamp.size.y);
+        stamp.rotations.resize(stamp.size.x * stamp.size.y);
+        for (u32 y = 0; y < stamp.size.y; y++)
+            tiles.ReadRow(v2i{from.x, from.y + (i32)y},
+                          stamp.size.x,
+                          &stamp.ids[y * stamp.size.x],
+                          &stamp.rotations[y * stamp.size.x]);
     }
 
-    void drawMap() {
-        for (i32 y = 0; y < (i32)(tilemap.size / tilemap.stride - 1); y++) {
-            for (i32 x = 0; x < (i32)tilemap.stride; x++) {
-                drawTile(tilemap[{x, y}], v2{x * tileSize, y * tileSize}, tileRotation[{x, y}]);
-            }
+    void pasteStamp(v2i at) {
+        journal.Begin();
+        for (u32 y = 0; y < stamp.size.y; y++)
+            writeRow(v2i{at.x, at.y + (i32)y},
+                     stamp.size.x,
+                     &stamp.ids[y * stamp.size.x],
+                     &stamp.rotations[y * stamp.size.x]);
+        journal.End();
+    }
+
+    // Holding the mouse down paints a single stroke, undone as one. Dragging with shift fills a
+    // rectangle, with alt a line, and with control copies the area as a stamp.
+    void paint() {
+        v2i tile = mouseTile();
+
+        bool shift   = IsKeyDown(KEY_LEFT_SHIFT);
+        bool alt     = IsKeyDown(KEY_LEFT_ALT);
+        bool control = IsKeyDown(KEY_LEFT_CONTROL);
+
+        if (IsKeyPressed(KEY_F))
+            floodFill(tile, selected, selectedRotation);
+        if (IsKeyPressed(KEY_R))
+            stamp = stamp.Rotated();
+        if (control && IsKeyPressed(KEY_V))
+            pasteStamp(tile);
+
+        // Strokes only start in the editor window, and a release without one is ignored: the
+        // press may have landed on the UI or in another scene.
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && !strokeOpen &&
+            vec2::IsInRectangle(GetMousePosition(), layoutRecs[EDITOR])) {
+            dragStart = tile;
+            journal.Begin();
+            strokeOpen = true;
+        }
+
+        if (strokeOpen && IsMouseButtonDown(MOUSE_BUTTON_LEFT) && !shift && !alt && !control)
+            placeTile();
+
+        if (strokeOpen && IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
+            if (shift)
+                fillRect(dragStart, tile, selected, selectedRotation);
+            else if (alt)
+                fillLine(dragStart, tile, selected, selectedRotation);
+            else if (control)
+                copyStamp(dragStart, tile);
+            endStroke();
         }
     }
 
-    void placeTile() {
-        v2 mousePosInCanvas = camera.Reproject(GetMousePosition());
+    void endStroke() {
+        if (!strokeOpen)
+            return;
 
-        tilemap[v2i{(i32)(mousePosInCanvas.x / tileSize), (i32)(mousePosInCanvas.y / tileSize)}] =
-            selected;
-        tileRotation[v2i{(i32)(mousePosInCanvas.x / tileSize),
-                         (i32)(mousePosInCanvas.y / tileSize)}] = selectedRotation;
+        journal.End();
+        strokeOpen = false;
     }
 
+    // Top-left of a tile in the selector, scrolled by whole rows.
+    v2 selectorPosition(i32 idx, i32 columns) {
+        return v2{layoutRecs[CHARSET].x + (idx % columns) * tileSize + tileSize,
+                  layoutRecs[CHARSET].y + (idx / columns - charsetScroll) * tileSize + tileSize};
+    }
+
+    // Only the rows in view are drawn, clipped to the selector, so its cost doesn't grow with
+    // the tileset.
     void drawTileSelector() {
-        if (vec2::IsInRectangle(GetMousePosition(), layoutRecs[CHARSET])) {
+        const Rectangle area    = layoutRecs[CHARSET];
+        const i32       columns = std::max(1, (i32)(area.width / tileSize - 2));
+        const i32       rows    = ((i32)tileset.Count() + columns - 1) / columns;
+        const i32       visible = std::max(1, (i32)((area.height - 10) / tileSize));
+
+        if (vec2::IsInRectangle(GetMousePosition(), area)) {
             if (GetMouseWheelMove() < 0)
                 charsetScroll++;
-            if (GetMouseWheelMove() > 0 && charsetScroll > 0)
+            if (GetMouseWheelMove() > 0)
                 charsetScroll--;
-
-            printf("%u\n", charsetScroll);
         }
+        charsetScroll = std::clamp(charsetScroll, 0, std::max(0, rows - visible));
 
         if (IsKeyPressed(KEY_K)) {
             selectedRotation = TileRotation((selectedRotation + 1) % 4);
         }
 
-        for (size_t i = 0;
-             // 1) Draw all tiles...
-             (i < tilesetSize * tilesetSize) !=
-             // 2) ...xor up to the height of the tile selector square
-             ((i32)(i / (layoutRecs[CHARSET].width / tileSize - 2)) * tileSize + tileSize -
-                  tileSize * charsetScroll >
-              layoutRecs[CHARSET].height - 10);
-             i++) {
-            drawTile(
-                i,
-                v2{layoutRecs[CHARSET].x, layoutRecs[CHARSET].y} +
-                    v2{(i % (i32)(layoutRecs[CHARSET].width / tileSize - 2)) * tileSize + tileSize,
-                       (i32)(i / (layoutRecs[CHARSET].width / tileSize - 2)) * tileSize + tileSize -
-                           tileSize * charsetScroll});
-        }
+        const i32 first = charsetScroll * columns;
+        const i32 last  = std::min((charsetScroll + visible) * columns, (i32)tileset.Count());
+
+        BeginScissorMode((i32)area.x, (i32)area.y, (i32)area.width, (i32)area.height);
+        for (i32 i = first; i < last; i++) drawTile(i, selectorPosition(i, columns));
 
         // Selected tile
-        DrawRectangleLines(
-            layoutRecs[CHARSET].x + tileSize +
-                tileSize * (selected % (i32)(layoutRecs[CHARSET].width / tileSize - 2)),
-            layoutRecs[CHARSET].y + -tileSize * charsetScroll + tileSize +
-                tileSize * (i32)(selected / (layoutRecs[CHARSET].width / tileSize - 2)),
-            tileSize,
-            tileSize,
-            RED);
-
-        // Look. This is a white rectangle on top of the tiles,
-        // so that the ones above the box don't render.
-        // I'm just tired.
-        DrawRectangle(layoutRecs[CHARSET].x,
-                      layoutRecs[CHARSET].y - 500,
-                      layoutRecs[CHARSET].width,
-                      layoutRecs[CHARSET].height + 185,
-                      RAYWHITE);
+        if (selected >= first && selected < last) {
+            v2 position = selectorPosition(selected, columns);
+            DrawRectangleLines(position.x, position.y, tileSize, tileSize, RED);
+        }
+        EndScissorMode();
 
         if (IsKeyPressed(KEY_COMMA)) {
-            selected = (selected - 1) % (tilesetSize * tilesetSize);
+            selected = (selected - 1) % tileset.Count();
         }
 
         if (IsKeyPressed(KEY_PERIOD)) {
-            selected = (selected + 1) % (tilesetSize * tilesetSize);
+            selected = (selected + 1) % tileset.Count();
         }
     }
 
@@ -206,26 +428,87 @@ class TileEditor : public Scene {
     void saveSerialized(const char *filename) {
         std::cout << "INFO: ENGINE: Saving asset as tilemap...\n";
 
-        auto          outpath = std::format("../assets/testing/{}.tm", filename);
-        std::ofstream outFile(outpath);
-        if (!outFile) {
-            std::cout << "ERROR: ENGINE: Error opening file for writing\n";
+        auto outpath = std::format("../assets/testing/{}.tmap", filename);
+        auto chunkAt = [this](ChunkCoords chunk, TileChunk &out) { tiles.Read(chunk, out); };
+
+        // Writing over the mapped file would change it under us, so write next to it and swap.
+        // Chunks the store doesn't hold are read from the old file until it's reopened.
+        auto temppath = outpath + ".tmp";
+        if (!tmap::Save(temppath.c_str(), mapSize, tiles.Chunks(), chunkAt))
             return;
-        }
 
-        for (i32 y = 0; y < (i32)(tilemap.size / tilemap.stride); y++) {
-            for (i32 x = 0; x < (i32)tilemap.stride; x++) {
-                outFile << tilemap[v2i{x, y}] << ' ';
-            }
-            outFile << '\n';
+        fs::rename(temppath, outpath);
+        mapFile.Open(outpath.c_str());
+
+        std::cout << "INFO: ENGINE: Saved asset to " << outpath << "\n";
+    }
+
+    // Opens a binary .tmap, or imports a text .tm if there's none.
+    void loadSerialized(const char *filename) {
+        auto binpath  = std::format("../assets/testing/{}.tmap", filename);
+        auto textpath = std::format("../assets/testing/{}.tm", filename);
+
+        if (fs::exists(binpath)) {
+            if (!mapFile.Open(binpath.c_str()))
+                return;
+
+            tiles.Clear(&mapFile);
+            journal.Clear();
+            resizeMap(mapFile.Size());
+        } else {
+            // Text maps are parsed on a worker and swapped in by finishImport().
+            importName    = filename;
+            pendingImport = assets.Load(std::function<ImportedMap()>([textpath] {
+                ImportedMap imported;
+                imported.ok = tmap::ImportText(textpath.c_str(), imported.size, imported.ids);
+                return imported;
+            }));
+            return;
         }
 
-        outFile.close();
-        if (outFile.fail()) {
-            std::cout << "ERROR: ENGINE: Error writing to file\n";
+        std::cout << "INFO: ENGINE: Loaded tilemap " << filename << " (" << mapSize.x << "x"
+                  << mapSize.y << ")\n";
+    }
+
+    void finishImport() {
+        if (!pendingImport.IsReady())
+            return;
+
+        const ImportedMap &imported = pendingImport.Get();
+        if (imported.ok) {
+            mapFile.Close();
+            tiles.Clear();
+            journal.Clear();
+            resizeMap(imported.size);
+            for (u32 y = 0; y < imported.size.y; y++)
+                tiles.WriteRow(v2i{0, (i32)y},
+                               imported.size.x,
+                               &imported.ids[y * imported.size.x],
+                               std::vector<u8>(imported.size.x, UP).data());
+
+            std::cout << "INFO: ENGINE: Loaded tilemap " << importName << " (" << mapSize.x << "x"
+                      << mapSize.y << ")\n";
         }
+        pendingImport = {};
+    }
 
-        std::cout << "INFO: ENGINE: Saved asset to " << outpath << "\n";
+    // The tileset loads in the background; the editor only draws and edits once it's in.
+    bool applyTileset() {
+        if (tilesetApplied || !tileset.ready)
+            return tilesetApplied;
+
+        tileSize = tileset.tileSize;
+        renderer.SetTileset(tileset);
+
+        status.charSheet      = tileset.texture;
+        status.charResolution = (u8)tileset.tileSize;
+        for (u32 tile = tileset.glyphs.size(); tile-- > 0;) {
+            const std::string &glyph = tileset.glyphs[tile];
+            if (glyph.size() == 1 && (u8)glyph[0] < 128)
+                asciiTiles[(u8)glyph[0]] = tile;
+        }
+        tilesetApplied = true;
+        return true;
     }
 
     void saveUI() {
@@ -242,37 +525,70 @@ class TileEditor : public Scene {
         }
     }
 
+    void historyUI() {
+        if (!IsKeyDown(KEY_LEFT_CONTROL))
+            return;
+
+        auto changed = [this](v2i tile) { renderer.MarkDirty(tile); };
+        if (IsKeyPressed(KEY_Z) && !IsKeyDown(KEY_LEFT_SHIFT))
+            journal.Undo(tiles, changed);
+        if (IsKeyPressed(KEY_Y) || (IsKeyPressed(KEY_Z) && IsKeyDown(KEY_LEFT_SHIFT)))
+            journal.Redo(tiles, changed);
+    }
+
+    void loadUI() {
+        static bool  loading  = false;
+        static char *loadName = (char *)calloc(20, 1);
+
+        if (IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_O)) {
+            loading = true;
+        }
+
+        if (loading && GuiTextBox(Rectangle{200, 200, 200, 20}, loadName, 20, true)) {
+            loadSerialized(loadName);
+            loading = false;
+        }
+    }
+
    public:
-    TileEditor(const char *uri, f32 _tileSize, u32 _tilesetSize, v2 dimensions)
-        : camera(),
-          tileset{LoadTexture(uri)},
-          tileSize{_tileSize},
-          tilesetSize{_tilesetSize},
-          tilemap{Array<u32>((dimensions.y + 1) * (dimensions.x + 1), 0, nullptr)},
-          tileRotation{Array<TileRotation>(
-              (dimensions.y + 1) * (dimensions.x + 1), TileRotation::UP, nullptr)} {
-        tilemap.stride      = (dimensions.x + 1);
-        tileRotation.stride = (dimensions.x + 1);
+    TileEditor(AssetManager &_assets, const Tileset &_tileset, v2 dimensions)
+        : assets{_assets},
+          tileset{_tileset},
+          tileSize{_tileset.tileSize},
+          mapSize{u32(dimensions.x + 1), u32(dimensions.y)},
+          renderer{tileset, mapSize} {
+        camera.offset = v2{layoutRecs[EDITOR].x, layoutRecs[EDITOR].y};
     }
 
+    // The map and grid are clipped to the editor window.
     void Draw2D() final {
-        // if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        //     placeTile();
-        // }
+        if (!tilesetApplied)
+            return;
+
+        paint();
 
-        // drawMap();
+        const Rectangle area = layoutRecs[EDITOR];
+        BeginScissorMode((i32)area.x, (i32)area.y, (i32)area.width, (i32)area.height);
+        drawMap();
 
-        // static bool showGrid = false;
-        // if (IsKeyPressed(KEY_G)) {
-        //     showGrid = !showGrid;
-        // }
-        // if (showGrid) {
-        //     drawGrid();
-        // }
+        if (IsKeyPressed(KEY_G)) {
+            showGrid = !showGrid;
+        }
+        if (showGrid) {
+            drawGrid();
+        }
+        EndScissorMode();
     }
 
     void DrawUI() final {
+        if (!tilesetApplied) {
+            DrawText("Loading tileset...", layoutRecs[EDITOR].x, layoutRecs[EDITOR].y, 20, GRAY);
+            return;
+        }
+
         saveUI();
+        loadUI();
+        historyUI();
 
         drawTileSelector();
         GuiGroupBox(layoutRecs[CHARSET], CharsetText);
@@ -299,12 +615,20 @@ class TileEditor : public Scene {
         if (GuiButton(layoutRecs[EXIT], ExitBtnText)) {
             ExitBtn();
         }
-        GuiPanel(layoutRecs[EDITOR], "");
+        DrawRectangleLinesEx(layoutRecs[EDITOR], 1, GRAY);  // A GuiPanel would cover the map
 
         drawSelected();
+        drawStatus();
     }
 
-    void Compute() final { camera.Update(); }
+    // A stroke still open when the scene is left ends there, so its undo step isn't lost.
+    void Exit() final { endStroke(); }
+
+    void Compute() final {
+        camera.Update();
+        applyTileset();
+        finishImport();
+    }
 };
 
 class MainMenu : public Scene {
@@ -0,0 +1,1128 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TILEMAP_MMAP
+#endif
+
+#include "tileset.hpp"
+
+#define TILE_CHUNK_SIZE 32                  // In tiles, per side
+#define DEFAULT_TILE_BUDGET (64 * 1024 * 1024)  // Bytes of resident chunks in a TileChunkStore
+#define DEFAULT_JOURNAL_BUDGET (16 * 1024 * 1024)  // Bytes of undo history in a TileJournal
+
+typedef Vector2i ChunkCoords;
+
+u64 ChunkKey(const ChunkCoords chunk) {
+    return (u64)(u32)chunk.x << 32 | (u32)chunk.y;
+}
+
+// Rounds toward negative infinity, for a positive divisor. Integer throughout, so chunks stay exact
+// however far from the origin a tile is.
+i32 FloorDiv(const i32 value, const i32 divisor) {
+    return value / divisor - (value % divisor < 0);
+}
+
+ChunkCoords ChunkOf(const v2i tile) {
+    return ChunkCoords{FloorDiv(tile.x, TILE_CHUNK_SIZE), FloorDiv(tile.y, TILE_CHUNK_SIZE)};
+}
+
+// Draws a tilemap in chunks of TILE_CHUNK_SIZE x TILE_CHUNK_SIZE tiles. Each chunk is baked into a
+// mesh of textured quads, with tile rotation folded into the texture coordinates, and drawn with a
+// single DrawMesh(). Chunks are only baked again after MarkDirty(), and only the ones the camera
+// sees are drawn, so the cost of a frame follows visible chunks rather than tiles.
+class TilemapRenderer {
+    static constexpr u32 TILES = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE;
+
+    struct Chunk {
+        Mesh mesh{};
+        bool dirty     = true;
+        u64  lastDrawn = 0;
+    };
+
+    std::unordered_map<u64, Chunk> chunks;
+    Material                       material;
+    std::vector<f32>               texcoords;  // Scratch for baking
+    u64                            frame = 0;
+    const Tileset*                 tileset;
+
+    // Meshes of chunks that scrolled out of view are dropped once they outnumber the visible ones,
+    // so panning across a large map doesn't keep every chunk ever seen on the GPU.
+    void trim(usize visible) {
+        if (chunks.size() <= 2 * visible + 64)
+            return;
+
+        std::erase_if(chunks, [this](auto& entry) {
+            if (entry.second.lastDrawn == frame)
+                return false;
+            if (entry.second.mesh.vaoId)
+                UnloadMesh(entry.second.mesh);
+            return true;
+        });
+    }
+
+    // Quads in TL, BL, BR, TR order, like raylib's own batch. Tiles outside the map are left
+    // degenerate.
+    Mesh createMesh(const ChunkCoords chunk) {
+        Mesh mesh{};
+        mesh.vertexCount   = TILES * 4;
+        mesh.triangleCount = TILES * 2;
+        mesh.vertices      = (f32*)MemAlloc(mesh.vertexCount * 3 * sizeof(f32));
+        mesh.texcoords     = (f32*)MemAlloc(mesh.vertexCount * 2 * sizeof(f32));
+        mesh.indices       = (u16*)MemAlloc(mesh.triangleCount * 3 * sizeof(u16));
+
+        for (u32 i = 0; i < TILES; i++) {
+            i32 x = chunk.x * TILE_CHUNK_SIZE + i % TILE_CHUNK_SIZE;
+            i32 y = chunk.y * TILE_CHUNK_SIZE + i / TILE_CHUNK_SIZE;
+
+            bool inside = x >= 0 && y >= 0 && x < (i32)size.x && y < (i32)size.y;
+            f32  side   = inside ? tileSize : 0;
+            f32  corners[4][2]{
+                {x * tileSize, y * tileSize},
+                {x * tileSize, y * tileSize + side},
+                {x * tileSize + side, y * tileSize + side},
+                {x * tileSize + side, y * tileSize},
+            };
+
+            for (u32 c = 0; c < 4; c++) {
+                mesh.vertices[(i * 4 + c) * 3 + 0] = corners[c][0];
+                mesh.vertices[(i * 4 + c) * 3 + 1] = corners[c][1];
+                mesh.vertices[(i * 4 + c) * 3 + 2] = 0;
+            }
+
+            u16 quad[6] = {0, 1, 2, 0, 2, 3};
+            for (u32 k = 0; k < 6; k++) mesh.indices[i * 6 + k] = u16(i * 4 + quad[k]);
+        }
+
+        UploadMesh(&mesh, true);
+        return mesh;
+    }
+
+    template <typename TileAt>
+    void bake(const ChunkCoords coords, Chunk& chunk, TileAt& tileAt) {
+        if (!chunk.mesh.vaoId)
+            chunk.mesh = createMesh(coords);
+
+        for (u32 i = 0; i < TILES; i++) {
+            i32 x = coords.x * TILE_CHUNK_SIZE + i % TILE_CHUNK_SIZE;
+            i32 y = coords.y * TILE_CHUNK_SIZE + i / TILE_CHUNK_SIZE;
+            if (x < 0 || y < 0 || x >= (i32)size.x || y >= (i32)size.y)
+                continue;
+
+            auto [idx, rotation] = tileAt(x, y);
+            memcpy(&texcoords[i * 8], tileset->UV(idx, rotation), 8 * sizeof(f32));
+        }
+
+        UpdateMeshBuffer(
+            chunk.mesh, 1, texcoords.data(), (i32)(texcoords.size() * sizeof(f32)), 0);
+        chunk.dirty = false;
+    }
+
+   public:
+    f32 tileSize;
+    v2u size;  // Map size in tiles
+
+    TilemapRenderer(const Tileset& _tileset, v2u _size)
+        : material{LoadMaterialDefault()},
+          texcoords(TILES * 4 * 2),
+          tileset{&_tileset},
+          tileSize{_tileset.tileSize},
+          size{_size} {
+        material.maps[MATERIAL_MAP_DIFFUSE].texture = tileset->texture;
+    }
+
+    TilemapRenderer(const TilemapRenderer&)            = delete;
+    TilemapRenderer& operator=(const TilemapRenderer&) = delete;
+
+    // UnloadMaterial() would unload the tileset as well, which isn't ours.
+    ~TilemapRenderer() {
+        for (auto& [key, chunk] : chunks)
+            if (chunk.mesh.vaoId)
+                UnloadMesh(chunk.mesh);
+        MemFree(material.maps);
+    }
+
+    // The chunk holding the tile is baked again before it's next drawn.
+    void MarkDirty(const v2i tile) {
+        auto it = chunks.find(ChunkKey(ChunkOf(tile)));
+        if (it != chunks.end())
+            it->second.dirty = true;
+    }
+
+    // Every chunk holding a tile between from and to, inclusive.
+    void MarkDirty(const v2i from, const v2i to) {
+        const ChunkCoords a = ChunkOf(v2i{std::min(from.x, to.x), std::min(from.y, to.y)});
+        const ChunkCoords b = ChunkOf(v2i{std::max(from.x, to.x), std::max(from.y, to.y)});
+        for (i32 y = a.y; y <= b.y; y++)
+            for (i32 x = a.x; x <= b.x; x++) {
+                auto it = chunks.find(ChunkKey({x, y}));
+                if (it != chunks.end())
+                    it->second.dirty = true;
+            }
+    }
+
+    void MarkAllDirty() {
+        for (auto& [key, chunk] : chunks) chunk.dirty = true;
+    }
+
+    // For when the tileset finishes loading, or changes. Meshes depend on the tile size, so
+    // they're all dropped.
+    void SetTileset(const Tileset& _tileset) {
+        tileset                                     = &_tileset;
+        tileSize                                    = _tileset.tileSize;
+        material.maps[MATERIAL_MAP_DIFFUSE].texture = _tileset.texture;
+        Resize(size);
+    }
+
+    // Chunk meshes depend on the map size, so they're all dropped.
+    void Resize(const v2u _size) {
+        for (auto& [key, chunk] : chunks)
+            if (chunk.mesh.vaoId)
+                UnloadMesh(chunk.mesh);
+        chunks.clear();
+        size = _size;
+    }
+
+    // Draws the chunks visible through the camera, baking them first if needed. tileAt(x, y)
+    // returns the {index, TileRotation} pair of a tile and is only called while baking. Must be
+    // called in 2D mode with the same camera.
+    template <typename TileAt>
+    void Draw(const Camera2D& camera, TileAt&& tileAt) {
+        v2 corners[4] = {GetScreenToWorld2D(v2{0, 0}, camera),
+                         GetScreenToWorld2D(v2{(f32)screenWidth, 0}, camera),
+                         GetScreenToWorld2D(v2{0, (f32)screenHeight}, camera),
+                         GetScreenToWorld2D(v2{(f32)screenWidth, (f32)screenHeight}, camera)};
+
+        v2 min = corners[0], max = corners[0];
+        for (const v2& corner : corners) {
+            min = v2{std::min(min.x, corner.x), std::min(min.y, corner.y)};
+            max = v2{std::max(max.x, corner.x), std::max(max.y, corner.y)};
+        }
+
+        const f32 chunkSide = tileSize * TILE_CHUNK_SIZE;
+        const i32 lastX     = (i32)((size.x + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE) - 1;
+        const i32 lastY     = (i32)((size.y + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE) - 1;
+
+        const i32 fromX = std::max(0, (i32)floorf(min.x / chunkSide));
+        const i32 fromY = std::max(0, (i32)floorf(min.y / chunkSide));
+        const i32 toX   = std::min(lastX, (i32)floorf(max.x / chunkSide));
+        const i32 toY   = std::min(lastY, (i32)floorf(max.y / chunkSide));
+
+        const Matrix identity{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+        frame++;
+        for (i32 y = fromY; y <= toY; y++)
+            for (i32 x = fromX; x <= toX; x++) {
+                Chunk& chunk = chunks[ChunkKey({x, y})];
+                if (chunk.dirty)
+                    bake({x, y}, chunk, tileAt);
+
+                chunk.lastDrawn = frame;
+                DrawMesh(chunk.mesh, material, identity);
+            }
+
+        trim((usize)std::max(0, toX - fromX + 1) * std::max(0, toY - fromY + 1));
+    }
+};
+
+#define GRID_SHADER_PATH "../shaders/glsl%i/grid.frag"  // By GLSL_VERSION
+
+// Tile grid drawn procedurally by the grid.frag shader over the map's rectangle. Only the part of
+// the rectangle on screen is shaded, so its cost follows the screen rather than the map or the
+// zoom. Major lines fall on chunk borders.
+class GridRenderer {
+    Shader shader{};
+    i32    tileSizeLoc, majorEveryLoc, offsetLoc, targetLoc, zoomLoc, rotationLoc, resolutionLoc;
+
+    void load() {
+        shader        = LoadShader(0, TextFormat(GRID_SHADER_PATH, GLSL_VERSION));
+        tileSizeLoc   = GetShaderLocation(shader, "tileSize");
+        majorEveryLoc = GetShaderLocation(shader, "majorEvery");
+        offsetLoc     = GetShaderLocation(shader, "offset");
+        targetLoc     = GetShaderLocation(shader, "target");
+        zoomLoc       = GetShaderLocation(shader, "zoom");
+        rotationLoc   = GetShaderLocation(shader, "rotation");
+        resolutionLoc = GetShaderLocation(shader, "resolution");
+    }
+
+   public:
+    Color color      = GRAY;
+    f32   majorEvery = TILE_CHUNK_SIZE;  // Tiles between major lines
+
+    GridRenderer() {}
+    GridRenderer(const GridRenderer&)            = delete;
+    GridRenderer& operator=(const GridRenderer&) = delete;
+
+    ~GridRenderer() {
+        if (shader.id)
+            UnloadShader(shader);
+    }
+
+    // Must be called in 2D mode with the same camera.
+    void Draw(const Camera2D& camera, f32 tileSize, v2u mapSize) {
+        if (!shader.id)
+            load();
+
+        const f32 rotation = camera.rotation * DEG2RAD;
+        const v2  resolution{(f32)screenWidth, (f32)screenHeight};
+
+        BeginShaderMode(shader);
+        SetShaderValue(shader, tileSizeLoc, &tileSize, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, majorEveryLoc, &majorEvery, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, offsetLoc, &camera.offset, SHADER_UNIFORM_VEC2);
+        SetShaderValue(shader, targetLoc, &camera.target, SHADER_UNIFORM_VEC2);
+        SetShaderValue(shader, zoomLoc, &camera.zoom, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, rotationLoc, &rotation, SHADER_UNIFORM_FLOAT);
+        SetShaderValue(shader, resolutionLoc, &resolution, SHADER_UNIFORM_VEC2);
+        DrawRectangleRec(Rectangle{0, 0, mapSize.x * tileSize, mapSize.y * tileSize}, color);
+        EndShaderMode();
+    }
+};
+
+// Tiles of one chunk, row by row.
+struct TileChunk {
+    u32 ids[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+    u8  rotations[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];  // TileRotation
+
+    bool IsEmpty() const {
+        for (u32 i = 0; i < TILE_CHUNK_SIZE * TILE_CHUNK_SIZE; i++)
+            if (ids[i] || rotations[i])
+                return false;
+        return true;
+    }
+};
+
+// Binary tilemap file (.tmap), little endian:
+//   Header
+//   Chunk payloads: the id plane, then the rotation plane, either raw or run-length encoded
+//   Chunk index: one ChunkEntry per stored chunk, at Header::indexOffset
+// Empty chunks aren't stored. The index lives at the end so chunks can be appended later by
+// writing them and a new index past the old one.
+namespace tmap {
+
+constexpr char MAGIC[4] = {'T', 'M', 'A', 'P'};
+constexpr u16  VERSION  = 1;
+
+enum Encoding : u32 { Raw = 0, Rle = 1 };
+
+struct Header {
+    char magic[4];
+    u16  version;
+    u16  chunkSize;
+    u32  width, height;  // In tiles
+    u32  chunkCount;
+    u32  reserved;
+    u64  indexOffset;
+};
+
+struct ChunkEntry {
+    i32      x, y;
+    u64      offset;
+    u32      size;
+    Encoding encoding;
+};
+
+// Runs of (u16 length, T value).
+template <typename T>
+void encodeRuns(const T* values, usize count, std::vector<u8>& out) {
+    for (usize i = 0; i < count;) {
+        usize run = 1;
+        while (i + run < count && run < UINT16_MAX && values[i + run] == values[i]) run++;
+
+        u16 length = (u16)run;
+        out.insert(out.end(), (u8*)&length, (u8*)&length + sizeof(u16));
+        out.insert(out.end(), (u8*)&values[i], (u8*)&values[i] + sizeof(T));
+        i += run;
+    }
+}
+
+template <typename T>
+const u8* decodeRuns(const u8* in, const u8* end, T* values, usize count) {
+    for (usize i = 0; i < count;) {
+        u16 length;
+        T   value;
+        if (end - in < (i64)(sizeof(u16) + sizeof(T)))
+            return nullptr;
+
+        memcpy(&length, in, sizeof(u16));
+        memcpy(&value, in + sizeof(u16), sizeof(T));
+        in += sizeof(u16) + sizeof(T);
+
+        if (length == 0 || i + length > count)
+            return nullptr;
+        std::fill_n(&values[i], length, value);
+        i += length;
+    }
+    return in;
+}
+
+// Appends the chunk's payload to out. Run-length encoded when asked to and when it's smaller.
+Encoding Encode(const TileChunk& chunk, std::vector<u8>& out, bool compress = true) {
+    const usize start = out.size();
+    if (compress) {
+        encodeRuns(chunk.ids, TILE_CHUNK_SIZE * TILE_CHUNK_SIZE, out);
+        encodeRuns(chunk.rotations, TILE_CHUNK_SIZE * TILE_CHUNK_SIZE, out);
+        if (out.size() - start < sizeof(TileChunk))
+            return Rle;
+        out.resize(start);
+    }
+
+    out.insert(out.end(), (u8*)&chunk, (u8*)&chunk + sizeof(TileChunk));
+    return Raw;
+}
+
+bool Decode(const u8* data, usize size, Encoding encoding, TileChunk& chunk) {
+    if (encoding == Raw) {
+        if (size != sizeof(TileChunk))
+            return false;
+        memcpy(&chunk, data, sizeof(TileChunk));
+        return true;
+    }
+
+    const u8* end = data + size;
+    data          = decodeRuns(data, end, chunk.ids, TILE_CHUNK_SIZE * TILE_CHUNK_SIZE);
+    if (data)
+        data = decodeRuns(data, end, chunk.rotations, TILE_CHUNK_SIZE * TILE_CHUNK_SIZE);
+    return data == end;
+}
+
+// Writes a map of the given size in tiles, made of the given chunks. chunkAt(coords, chunk) fills
+// in a chunk.
+template <typename ChunkAt>
+bool Save(const char*                     path,
+          v2u                             size,
+          const std::vector<ChunkCoords>& chunks,
+          ChunkAt&&                       chunkAt,
+          bool                            compress = true) {
+    std::ofstream outFile(path, std::ios::binary);
+    if (!outFile) {
+        std::cout << "ERROR: ENGINE: Error opening file for writing: " << path << "\n";
+        return false;
+    }
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version   = VERSION;
+    header.chunkSize = TILE_CHUNK_SIZE;
+    header.width     = size.x;
+    header.height    = size.y;
+    outFile.write((const char*)&header, sizeof(Header));
+
+    std::vector<ChunkEntry> index;
+    std::vector<u8>         payload;
+    TileChunk               chunk;
+    u64                     offset = sizeof(Header);
+
+    for (const ChunkCoords coords : chunks) {
+        chunkAt(coords, chunk);
+        if (chunk.IsEmpty())
+            continue;
+
+        payload.clear();
+        Encoding encoding = Encode(chunk, payload, compress);
+        outFile.write((const char*)payload.data(), payload.size());
+
+        index.push_back(ChunkEntry{coords.x, coords.y, offset, (u32)payload.size(), encoding});
+        offset += payload.size();
+    }
+
+    header.chunkCount  = (u32)index.size();
+    header.indexOffset = offset;
+    outFile.write((const char*)index.data(), index.size() * sizeof(ChunkEntry));
+    outFile.seekp(0);
+    outFile.write((const char*)&header, sizeof(Header));
+
+    outFile.close();
+    if (outFile.fail()) {
+        std::cout << "ERROR: ENGINE: Error writing to file: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads the old whitespace separated text tilemaps (.tm), one row per line. Rotations weren't
+// saved in them.
+bool ImportText(const char* path, v2u& size, std::vector<u32>& ids) {
+    std::ifstream inFile(path);
+    if (!inFile) {
+        std::cout << "ERROR: ENGINE: Error opening file for reading: " << path << "\n";
+        return false;
+    }
+
+    std::vector<std::vector<u32>> rows;
+    std::string                   line;
+    while (std::getline(inFile, line)) {
+        std::vector<u32> row;
+        const char*      c   = line.c_str();
+        char*            end = nullptr;
+
+        for (u32 id = strtoul(c, &end, 10); end != c; id = strtoul(c, &end, 10)) {
+            row.push_back(id);
+            c = end;
+        }
+        if (!row.empty())
+            rows.push_back(std::move(row));
+    }
+
+    size = v2u{0, (u32)rows.size()};
+    for (auto& row : rows) size.x = std::max(size.x, (u32)row.size());
+
+    ids.assign(size.x * size.y, 0);
+    for (u32 y = 0; y < size.y; y++) std::copy(rows[y].begin(), rows[y].end(), &ids[y * size.x]);
+    return true;
+}
+
+}  // namespace tmap
+
+// Read-only .tmap file. Opening it only reads the header and the chunk index; chunks are decoded
+// on request straight from the memory mapped file, so the OS only pages in the parts of the map
+// that get used. Where mmap isn't available (Windows, web) the file is read into memory instead.
+class MappedTilemap {
+    const u8*       data   = nullptr;
+    usize           length = 0;
+    std::vector<u8> contents;  // Without mmap
+
+    tmap::Header                              header{};
+    std::unordered_map<u64, tmap::ChunkEntry> index;
+
+   public:
+    void Close() {
+#if defined(TILEMAP_MMAP)
+        if (data && contents.empty())
+            munmap((void*)data, length);
+#endif
+        contents.clear();
+        index.clear();
+        data   = nullptr;
+        length = 0;
+    }
+
+   private:
+    bool map(const char* path) {
+#if defined(TILEMAP_MMAP)
+        i32 fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data   = (const u8*)mapped;
+                length = info.st_size;
+            }
+        }
+        ::close(fd);
+        return data != nullptr;
+#else
+        std::ifstream inFile(path, std::ios::binary);
+        if (!inFile)
+            return false;
+
+        contents.assign(std::istreambuf_iterator<char>(inFile), {});
+        data   = contents.data();
+        length = contents.size();
+        return !contents.empty();
+#endif
+    }
+
+   public:
+    MappedTilemap() {}
+    explicit MappedTilemap(const char* path) { Open(path); }
+    MappedTilemap(const MappedTilemap&)            = delete;
+    MappedTilemap& operator=(const MappedTilemap&) = delete;
+    ~MappedTilemap() { Close(); }
+
+    bool Open(const char* path) {
+        Close();
+        if (!map(path)) {
+            std::cout << "ERROR: ENGINE: Error opening tilemap: " << path << "\n";
+            return false;
+        }
+
+        if (length >= sizeof(tmap::Header))
+            memcpy(&header, data, sizeof(tmap::Header));
+
+        if (length < sizeof(tmap::Header) || memcmp(header.magic, tmap::MAGIC, 4) != 0 ||
+            header.version != tmap::VERSION || header.chunkSize != TILE_CHUNK_SIZE ||
+            header.indexOffset + header.chunkCount * sizeof(tmap::ChunkEntry) > length) {
+            std::cout << "ERROR: ENGINE: Not a valid version " << tmap::VERSION
+                      << " tilemap: " << path << "\n";
+            Close();
+            return false;
+        }
+
+        for (u32 i = 0; i < header.chunkCount; i++) {
+            tmap::ChunkEntry entry;
+            memcpy(&entry, data + header.indexOffset + i * sizeof(tmap::ChunkEntry), sizeof(entry));
+            if (entry.offset + entry.size <= length)
+                index[ChunkKey({entry.x, entry.y})] = entry;
+        }
+
+        return true;
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+
+    // In tiles.
+    v2u Size() const { return v2u{header.width, header.height}; }
+
+    bool Has(const ChunkCoords coords) const { return index.contains(ChunkKey(coords)); }
+
+    // Coordinates of every stored chunk.
+    std::vector<ChunkCoords> Chunks() const {
+        std::vector<ChunkCoords> result;
+        for (auto& [key, entry] : index) result.push_back(ChunkCoords{entry.x, entry.y});
+        return result;
+    }
+
+    // Decodes a chunk. Chunks that aren't stored are empty.
+    bool Read(const ChunkCoords coords, TileChunk& chunk) const {
+        auto it = index.find(ChunkKey(coords));
+        if (it == index.end()) {
+            memset(&chunk, 0, sizeof(TileChunk));
+            return true;
+        }
+
+        const tmap::ChunkEntry& entry = it->second;
+        if (!tmap::Decode(data + entry.offset, entry.size, entry.encoding, chunk)) {
+            std::cout << "ERROR: ENGINE: Corrupt tilemap chunk " << coords.x << ", " << coords.y
+                      << "\n";
+            memset(&chunk, 0, sizeof(TileChunk));
+            return false;
+        }
+        return true;
+    }
+};
+
+// Sparse tile storage for maps of any size. A chunk gets a block from the pool the first time one
+// of its tiles is written; everywhere else reads as empty tiles. Chunks never written can come from
+// a source map file, read when first touched. Once resident chunks outgrow the budget the least
+// recently used ones are evicted: edited chunks are appended to a spill file in the .tmap chunk
+// encoding, the others are dropped and read again from wherever they came from.
+class TileChunkStore {
+    struct Resident {
+        TileChunk*  tiles;
+        ChunkCoords coords;
+        u64         lastUse;
+        bool        edited;
+    };
+
+    std::deque<TileChunk>                     blocks;  // Pool, addresses stay put as it grows
+    std::vector<TileChunk*>                   freeBlocks;
+    std::unordered_map<u64, Resident>         resident;
+    std::unordered_map<u64, tmap::ChunkEntry> spilled;  // Offsets into the spill file
+    const MappedTilemap*                      source = nullptr;
+
+    std::string     spillPath;
+    std::fstream    spill;
+    u64             spillEnd = 0;
+    std::vector<u8> payload;  // Scratch for spill reads and writes
+
+    u64       useClock = 0;
+    u64       lastKey  = 0;
+    Resident* last     = nullptr;  // Most lookups hit the same chunk as the one before
+
+    TileChunk* allocate() {
+        if (freeBlocks.empty())
+            return &blocks.emplace_back();
+
+        TileChunk* block = freeBlocks.back();
+        freeBlocks.pop_back();
+        return block;
+    }
+
+    bool isStored(u64 key, ChunkCoords coords) const {
+        return spilled.contains(key) || (source && source->Has(coords));
+    }
+
+    // Reads a chunk that isn't resident. False if it was never stored, i.e. it's empty.
+    bool load(u64 key, ChunkCoords coords, TileChunk& tiles) {
+        auto it = spilled.find(key);
+        if (it != spilled.end()) {
+            const tmap::ChunkEntry& entry = it->second;
+
+            payload.resize(entry.size);
+            spill.seekg(entry.offset);
+            spill.read((char*)payload.data(), entry.size);
+            if (!spill || !tmap::Decode(payload.data(), entry.size, entry.encoding, tiles)) {
+                std::cout << "ERROR: ENGINE: Corrupt spilled tilemap chunk " << coords.x << ", "
+                          << coords.y << "\n";
+                spill.clear();
+                memset(&tiles, 0, sizeof(TileChunk));
+            }
+            return true;
+        }
+
+        if (source && source->Has(coords))
+            return source->Read(coords, tiles), true;
+
+        return false;
+    }
+
+    bool writeSpill(u64 key, const Resident& chunk) {
+        if (chunk.tiles->IsEmpty() && !(source && source->Has(chunk.coords))) {
+            spilled.erase(key);
+            return true;
+        }
+
+        if (!spill.is_open()) {
+            spill.open(spillPath,
+                       std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            spillEnd = 0;
+        }
+
+        payload.clear();
+        tmap::Encoding encoding = tmap::Encode(*chunk.tiles, payload);
+
+        spill.seekp(spillEnd);
+        spill.write((const char*)payload.data(), payload.size());
+        if (!spill) {
+            std::cout << "ERROR: ENGINE: Error writing to file: " << spillPath << "\n";
+            spill.clear();
+            return false;
+        }
+
+        spilled[key] = tmap::ChunkEntry{
+            chunk.coords.x, chunk.coords.y, spillEnd, (u32)payload.size(), encoding};
+        spillEnd += payload.size();
+        return true;
+    }
+
+    // Evicts the coldest eighth of the resident chunks.
+    void evict() {
+        std::vector<std::pair<u64, u64>> ages;  // Last use, key
+        ages.reserve(resident.size());
+        for (auto& [key, chunk] : resident) ages.push_back({chunk.lastUse, key});
+
+        const usize count = std::max<usize>(1, ages.size() / 8);
+        std::nth_element(ages.begin(), ages.begin() + (count - 1), ages.end());
+
+        for (usize i = 0; i < count; i++) {
+            auto it = resident.find(ages[i].second);
+            if (it->second.edited && !writeSpill(it->first, it->second))
+                continue;  // Over budget beats losing edits
+
+            freeBlocks.push_back(it->second.tiles);
+            resident.erase(it);
+        }
+        last = nullptr;
+    }
+
+    // Resident chunk, read in or allocated as needed. Null if it's empty and create isn't set.
+    Resident* find(const ChunkCoords coords, bool create) {
+        const u64 key = ChunkKey(coords);
+        if (last && lastKey == key) {
+            last->lastUse = ++useClock;
+            return last;
+        }
+
+        auto it = resident.find(key);
+        if (it == resident.end()) {
+            if (!create && !isStored(key, coords))
+                return nullptr;
+
+            if (resident.size() >= Capacity())
+                evict();
+
+            TileChunk* tiles = allocate();
+            if (!load(key, coords, *tiles))
+                memset(tiles, 0, sizeof(TileChunk));
+            it = resident.emplace(key, Resident{tiles, coords, 0, false}).first;
+        }
+
+        it->second.lastUse = ++useClock;
+        lastKey            = key;
+        last               = &it->second;
+        return last;
+    }
+
+    static u32 indexIn(const ChunkCoords chunk, const v2i tile) {
+        return (tile.y - chunk.y * TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE +
+               (tile.x - chunk.x * TILE_CHUNK_SIZE);
+    }
+
+    // Splits a row of tiles at chunk borders. span(chunk, index in chunk, count, tiles before).
+    template <typename Span>
+    static void forEachSpan(const v2i start, u32 length, Span&& span) {
+        for (u32 done = 0; done < length;) {
+            const v2i         tile{start.x + (i32)done, start.y};
+            const ChunkCoords chunk = ChunkOf(tile);
+            const u32         i     = indexIn(chunk, tile);
+            const u32 count = std::min(length - done, TILE_CHUNK_SIZE - i % TILE_CHUNK_SIZE);
+
+            span(chunk, i, count, done);
+            done += count;
+        }
+    }
+
+   public:
+    usize budget;  // Bytes of resident chunks
+
+    explicit TileChunkStore(usize _budget = DEFAULT_TILE_BUDGET)
+        : spillPath{(fs::temp_directory_path() / std::format("tiles-{}.spill", (void*)this))
+                        .string()},
+          budget{_budget} {}
+
+    TileChunkStore(const TileChunkStore&)            = delete;
+    TileChunkStore& operator=(const TileChunkStore&) = delete;
+
+    ~TileChunkStore() {
+        spill.close();
+        std::error_code ignored;
+        fs::remove(spillPath, ignored);
+    }
+
+    // Drops every chunk. Chunks are then read from the source, if there is one, until written.
+    // The source must outlive the store or the next Clear().
+    void Clear(const MappedTilemap* _source = nullptr) {
+        blocks.clear();
+        freeBlocks.clear();
+        resident.clear();
+        spilled.clear();
+        spillEnd = 0;
+        if (spill.is_open())
+            spill.close();
+
+        source = _source;
+        last   = nullptr;
+    }
+
+    usize Capacity() const { return std::max<usize>(1, budget / sizeof(TileChunk)); }
+    usize ResidentCount() const { return resident.size(); }
+    usize SpilledCount() const { return spilled.size(); }
+
+    // Null for empty chunks. Valid until the next Find() or Edit(), which may evict it.
+    const TileChunk* Find(const ChunkCoords coords) {
+        Resident* chunk = find(coords, false);
+        return chunk ? chunk->tiles : nullptr;
+    }
+
+    // Chunk for writing to, allocated if needed. Same lifetime as Find().
+    TileChunk& Edit(const ChunkCoords coords) {
+        Resident* chunk = find(coords, true);
+        chunk->edited   = true;
+        return *chunk->tiles;
+    }
+
+    std::pair<u32, TileRotation> Get(const v2i tile) {
+        const ChunkCoords chunk = ChunkOf(tile);
+        const TileChunk*  tiles = Find(chunk);
+        if (!tiles)
+            return {0, UP};
+
+        const u32 i = indexIn(chunk, tile);
+        return {tiles->ids[i], TileRotation(tiles->rotations[i])};
+    }
+
+    void Set(const v2i tile, u32 id, TileRotation rotation) {
+        const ChunkCoords chunk = ChunkOf(tile);
+        if (id == 0 && rotation == UP && !Find(chunk))
+            return;  // Already empty
+
+        TileChunk& tiles   = Edit(chunk);
+        const u32  i       = indexIn(chunk, tile);
+        tiles.ids[i]       = id;
+        tiles.rotations[i] = (u8)rotation;
+    }
+
+    // Tiles equal to value in a row from start, rightwards if step is 1 and leftwards if it's -1,
+    // up to limit. One lookup per chunk crossed.
+    u32 CountRun(const v2i start, i32 step, u32 limit, std::pair<u32, TileRotation> value) {
+        u32 count = 0;
+        while (count < limit) {
+            const v2i         tile{start.x + step * (i32)count, start.y};
+            const ChunkCoords chunk = ChunkOf(tile);
+            const TileChunk*  tiles = Find(chunk);
+            const u32         i     = indexIn(chunk, tile);
+
+            // Tiles of the chunk row left in that direction, this one included.
+            const u32 column = i % TILE_CHUNK_SIZE;
+            const u32 left   = step > 0 ? TILE_CHUNK_SIZE - column : column + 1;
+            const u32 span   = std::min(limit - count, left);
+            if (!tiles) {
+                if (value != std::pair<u32, TileRotation>{0, UP})
+                    return count;
+                count += span;
+                continue;
+            }
+
+            for (u32 j = 0; j < span; j++) {
+                const u32 k = i + step * (i32)j;
+                if (tiles->ids[k] != value.first || tiles->rotations[k] != value.second)
+                    return count + j;
+            }
+            count += span;
+        }
+        return count;
+    }
+
+    // Copies length tiles rightwards from start, a chunk row at a time.
+    void ReadRow(const v2i start, u32 length, u32* ids, u8* rotations) {
+        forEachSpan(start, length, [&](ChunkCoords chunk, u32 i, u32 count, u32 done) {
+            const TileChunk* tiles = Find(chunk);
+            if (!tiles) {
+                std::fill_n(ids + done, count, 0);
+                std::fill_n(rotations + done, count, (u8)UP);
+                return;
+            }
+            memcpy(ids + done, tiles->ids + i, count * sizeof(u32));
+            memcpy(rotations + done, tiles->rotations + i, count);
+        });
+    }
+
+    void WriteRow(const v2i start, u32 length, const u32* ids, const u8* rotations) {
+        forEachSpan(start, length, [&](ChunkCoords chunk, u32 i, u32 count, u32 done) {
+            bool empty = std::all_of(ids + done, ids + done + count, [](u32 id) { return !id; }) &&
+                         std::all_of(rotations + done, rotations + done + count, [](u8 r) {
+                             return r == UP;
+                         });
+            if (empty && !Find(chunk))
+                return;
+
+            TileChunk& tiles = Edit(chunk);
+            memcpy(tiles.ids + i, ids + done, count * sizeof(u32));
+            memcpy(tiles.rotations + i, rotations + done, count);
+        });
+    }
+
+    // Copies a chunk out without making it resident, for saving. False if it's empty.
+    bool Read(const ChunkCoords coords, TileChunk& tiles) {
+        auto it = resident.find(ChunkKey(coords));
+        if (it != resident.end())
+            return memcpy(&tiles, it->second.tiles, sizeof(TileChunk)), true;
+
+        if (load(ChunkKey(coords), coords, tiles))
+            return true;
+
+        memset(&tiles, 0, sizeof(TileChunk));
+        return false;
+    }
+
+    // Every chunk that may hold tiles, row by row.
+    std::vector<ChunkCoords> Chunks() const {
+        std::unordered_map<u64, ChunkCoords> all;
+        for (auto& [key, chunk] : resident) all[key] = chunk.coords;
+        for (auto& [key, entry] : spilled) all[key] = ChunkCoords{entry.x, entry.y};
+        if (source)
+            for (const ChunkCoords coords : source->Chunks()) all[ChunkKey(coords)] = coords;
+
+        std::vector<ChunkCoords> result;
+        result.reserve(all.size());
+        for (auto& [key, coords] : all) result.push_back(coords);
+
+        std::sort(result.begin(), result.end(), [](ChunkCoords a, ChunkCoords b) {
+            return a.y != b.y ? a.y < b.y : a.x < b.x;
+        });
+        return result;
+    }
+};
+
+// Undo history for a TileChunkStore. Edits between Begin() and End() are coalesced into a single
+// command that keeps only the cells that changed, with the first value and last value of each, so a
+// stroke painting over the same tiles every frame is one undo step. Commands are stored as spans of
+// neighbouring cells in a row, each with its before and after values run-length encoded, so their
+// size follows the change rather than the map. The oldest commands are dropped past the budget.
+class TileJournal {
+    struct Command {
+        std::vector<u8> data;  // Spans: i32 x, i32 y, u32 length, runs before, runs after
+        usize           cells;
+    };
+
+    std::deque<Command> commands;
+    usize               cursor = 0;  // Commands before it can be undone, the rest redone
+    usize               bytes  = 0;
+
+    u32                                           depth = 0;
+    std::unordered_map<u64, std::pair<u64, u64>> pending;  // Tile -> before, after
+
+    std::vector<u64> before, after;  // Scratch for spans
+
+    static u64 pack(u32 id, TileRotation rotation) { return (u64)rotation << 32 | id; }
+
+    template <typename Changed>
+    void apply(TileChunkStore& store, const Command& command, bool undo, Changed& changed) {
+        const u8* in  = command.data.data();
+        const u8* end = in + command.data.size();
+
+        while (in < end) {
+            i32 x, y;
+            u32 length;
+            memcpy(&x, in, sizeof(i32));
+            memcpy(&y, in + sizeof(i32), sizeof(i32));
+            memcpy(&length, in + 2 * sizeof(i32), sizeof(u32));
+            in += 2 * sizeof(i32) + sizeof(u32);
+
+            before.resize(length);
+            after.resize(length);
+            in = tmap::decodeRuns(in, end, before.data(), length);
+            in = tmap::decodeRuns(in, end, after.data(), length);
+            assert(in && "Corrupt journal command");
+
+            const std::vector<u64>& values = undo ? before : after;
+            for (u32 i = 0; i < length; i++) {
+                store.Set(v2i{x + (i32)i, y}, (u32)values[i], TileRotation(values[i] >> 32));
+                changed(v2i{x + (i32)i, y});
+            }
+        }
+    }
+
+    void push(Command&& command) {
+        while (commands.size() > cursor) {
+            bytes -= commands.back().data.size();
+            commands.pop_back();
+        }
+
+        bytes += command.data.size();
+        commands.push_back(std::move(command));
+        cursor++;
+
+        while ((bytes > budget || commands.size() > maxCommands) && commands.size() > 1) {
+            bytes -= commands.front().data.size();
+            commands.pop_front();
+            cursor--;
+        }
+    }
+
+   public:
+    usize budget      = DEFAULT_JOURNAL_BUDGET;  // Bytes
+    usize maxCommands = 256;
+
+    // Begin() and End() nest, the outermost pair makes the command.
+    void Begin() { depth++; }
+
+    void End() {
+        assert(depth > 0 && "TileJournal::End() without Begin()");
+        if (--depth > 0)
+            return;
+
+        std::vector<std::pair<v2i, std::pair<u64, u64>>> cells;
+        cells.reserve(pending.size());
+        for (auto& [key, change] : pending)
+            if (change.first != change.second)
+                cells.push_back({v2i{(i32)(key >> 32), (i32)(u32)key}, change});
+        pending.clear();
+
+        if (cells.empty())
+            return;
+
+        std::sort(cells.begin(), cells.end(), [](auto& a, auto& b) {
+            return a.first.y != b.first.y ? a.first.y < b.first.y : a.first.x < b.first.x;
+        });
+
+        Command command{{}, cells.size()};
+        for (usize i = 0; i < cells.size();) {
+            usize length = 1;
+            while (i + length < cells.size() && cells[i + length].first.y == cells[i].first.y &&
+                   cells[i + length].first.x == cells[i].first.x + (i32)length)
+                length++;
+
+            before.resize(length);
+            after.resize(length);
+            for (usize j = 0; j < length; j++) {
+                before[j] = cells[i + j].second.first;
+                after[j]  = cells[i + j].second.second;
+            }
+
+            const v2i start = cells[i].first;
+            const u32 count = (u32)length;
+            command.data.insert(command.data.end(), (u8*)&start.x, (u8*)&start.x + sizeof(i32));
+            command.data.insert(command.data.end(), (u8*)&start.y, (u8*)&start.y + sizeof(i32));
+            command.data.insert(command.data.end(), (u8*)&count, (u8*)&count + sizeof(u32));
+            tmap::encodeRuns(before.data(), length, command.data);
+            tmap::encodeRuns(after.data(), length, command.data);
+            i += length;
+        }
+
+        command.data.shrink_to_fit();
+        push(std::move(command));
+    }
+
+    // Call for every tile written while a command is open.
+    void Record(const v2i    tile,
+                u32          oldId,
+                TileRotation oldRotation,
+                u32          newId,
+                TileRotation newRotation) {
+        assert(depth > 0 && "TileJournal::Record() outside Begin() and End()");
+
+        auto [it, inserted] = pending.try_emplace(ChunkKey(tile));
+        if (inserted)
+            it->second.first = pack(oldId, oldRotation);
+        it->second.second = pack(newId, newRotation);
+    }
+
+    void RecordRow(const v2i  start,
+                   u32        length,
+                   const u32* oldIds,
+                   const u8*  oldRotations,
+                   const u32* newIds,
+                   const u8*  newRotations) {
+        for (u32 i = 0; i < length; i++)
+            if (oldIds[i] != newIds[i] || oldRotations[i] != newRotations[i])
+                Record(v2i{start.x + (i32)i, start.y},
+                       oldIds[i],
+                       TileRotation(oldRotations[i]),
+                       newIds[i],
+                       TileRotation(newRotations[i]));
+    }
+
+    bool CanUndo() const { return depth == 0 && cursor > 0; }
+    bool CanRedo() const { return depth == 0 && cursor < commands.size(); }
+
+    // changed(tile) is called for every tile written back.
+    template <typename Changed>
+    bool Undo(TileChunkStore& store, Changed&& changed) {
+        if (!CanUndo())
+            return false;
+        apply(store, commands[--cursor], true, changed);
+        return true;
+    }
+
+    template <typename Changed>
+    bool Redo(TileChunkStore& store, Changed&& changed) {
+        if (!CanRedo())
+            return false;
+        apply(store, commands[cursor++], false, changed);
+        return true;
+    }
+
+    void Clear() {
+        commands.clear();
+        pending.clear();
+        cursor = 0;
+        bytes  = 0;
+    }
+
+    usize Bytes() const { return bytes; }
+};
+
+// Block of tiles copied out of a map, for pasting elsewhere.
+struct TileStamp {
+    v2u              size{};
+    std::vector<u32> ids;
+    std::vector<u8>  rotations;  // TileRotation
+
+    bool IsEmpty() const { return size.x == 0 || size.y == 0; }
+
+    // A quarter turn clockwise, tiles included.
+    TileStamp Rotated() const {
+        TileStamp rotated{
+            v2u{size.y, size.x}, std::vector<u32>(ids.size()), std::vector<u8>(ids.size())};
+        for (u32 y = 0; y < size.y; y++)
+            for (u32 x = 0; x < size.x; x++) {
+                const u32 from = y * size.x + x;
+                const u32 to   = x * rotated.size.x + (size.y - 1 - y);
+
+                rotated.ids[to]       = ids[from];
+                rotated.rotations[to] = (rotations[from] + 1) % 4;
+            }
+        return rotated;
+    }
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "assets.hpp"
+
+enum TileRotation { UP = 0, RIGHT = 1, DOWN = 2, LEFT = 3 };
+
+// A tileset texture and its .char sidecar:
+//   // Name of the tileset
+//   Image file, next to the .char
+//   Columns, rows
+//   One row of glyphs per row of tiles, one UTF-8 character per tile
+//   // end
+// Texture coordinates of every tile in every rotation are worked out once on load, so drawing a
+// tile is a table lookup. Until ready, a tileset is a blank 1x1 placeholder.
+struct Tileset {
+    bool                     ready = false;
+    std::string              name;
+    Texture                  texture{};
+    v2u                      grid{1, 1};    // Tiles per row and column
+    f32                      tileSize = 8;  // Pixels per side
+    std::vector<std::string> glyphs;        // Per tile, empty where the .char has none
+    std::vector<Rectangle>   sources;       // Per tile, in pixels
+    std::vector<f32>         texcoords;     // Per tile and rotation, see UV()
+
+    u32 Count() const { return grid.x * grid.y; }
+
+    // Eight floats: the UVs of the tile's TL, BL, BR, TR corners on screen, turned clockwise by
+    // rotation quarter turns. Same vertex order as raylib's own quads and TilemapRenderer.
+    const f32* UV(u32 tile, TileRotation rotation) const {
+        return &texcoords[((tile % Count()) * 4 + rotation) * 8];
+    }
+
+    void Draw(u32 tile, TileRotation rotation, Rectangle dest, Color tint = WHITE) const {
+        const f32* uv = UV(tile, rotation);
+        const v2   corners[4]{{dest.x, dest.y},
+                              {dest.x, dest.y + dest.height},
+                              {dest.x + dest.width, dest.y + dest.height},
+                              {dest.x + dest.width, dest.y}};
+
+        rlSetTexture(texture.id);
+        rlBegin(RL_QUADS);
+        rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+        rlNormal3f(0, 0, 1);
+        for (u32 c = 0; c < 4; c++) {
+            rlTexCoord2f(uv[c * 2], uv[c * 2 + 1]);
+            rlVertex2f(corners[c].x, corners[c].y);
+        }
+        rlEnd();
+        rlSetTexture(0);
+    }
+
+    void BuildTables() {
+        sources.resize(Count());
+        texcoords.resize(Count() * 4 * 8);
+
+        for (u32 tile = 0; tile < Count(); tile++) {
+            const u32 column = tile % grid.x, row = tile / grid.x;
+            sources[tile] = Rectangle{column * tileSize, row * tileSize, tileSize, tileSize};
+
+            f32 u0 = (f32)column / grid.x, u1 = (f32)(column + 1) / grid.x;
+            f32 v0 = (f32)row / grid.y, v1 = (f32)(row + 1) / grid.y;
+
+            // Corners clockwise from the top-left. Rotating the tile clockwise by r quarter turns
+            // shows texture corner (c - r) at screen corner c.
+            f32 uv[4][2]  = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+            u32 screen[4] = {0, 3, 2, 1};  // Clockwise corner of each vertex, TL BL BR TR
+            for (u32 rotation = 0; rotation < 4; rotation++)
+                for (u32 c = 0; c < 4; c++) {
+                    const f32* corner = uv[(screen[c] + 4 - rotation) % 4];
+                    f32*       out    = &texcoords[((tile * 4 + rotation) * 4 + c) * 2];
+                    out[0]            = corner[0];
+                    out[1]            = corner[1];
+                }
+        }
+    }
+};
+
+// Tilesets by the stem of their .char file, each loaded once on first use. The .char is parsed and
+// the image decoded on the asset manager's workers, and the texture uploaded in its Update().
+class TilesetRegistry {
+    AssetManager&                                             assets;
+    std::string                                               directory;
+    std::unordered_map<std::string, std::unique_ptr<Tileset>> tilesets;
+
+    struct Decoded {
+        Tileset  tileset;
+        Image    image{};
+        fs::path imagePath;
+    };
+
+    // Splits a line into UTF-8 characters.
+    static std::vector<std::string> splitGlyphs(const std::string& line) {
+        std::vector<std::string> glyphs;
+        for (usize i = 0; i < line.size();) {
+            u8    lead   = line[i];
+            usize length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+            glyphs.push_back(line.substr(i, length));
+            i += length;
+        }
+        return glyphs;
+    }
+
+    static bool parseChar(const fs::path& path, Tileset& tileset, std::string& image) {
+        std::ifstream inFile(path);
+        if (!inFile) {
+            std::cout << "ERROR: ENGINE: Error opening file for reading: " << path << "\n";
+            return false;
+        }
+
+        // Lines may end in CRLF.
+        auto readLine = [&inFile](std::string& line) {
+            if (!std::getline(inFile, line))
+                return false;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            return true;
+        };
+
+        std::string header, grid;
+        readLine(header);
+        readLine(image);
+        readLine(grid);
+
+        if (header.rfind("//", 0) != 0 ||
+            sscanf(grid.c_str(), "%u , %u", &tileset.grid.x, &tileset.grid.y) != 2 ||
+            tileset.grid.x == 0 || tileset.grid.y == 0) {
+            std::cout << "ERROR: ENGINE: Not a valid .char file: " << path << "\n";
+            return false;
+        }
+
+        const usize start = header.find_first_not_of("/ \t");
+        const usize end   = header.find_last_not_of(" \t");
+        tileset.name      = start == std::string::npos ? "" : header.substr(start, end + 1 - start);
+
+        tileset.glyphs.assign(tileset.grid.x * tileset.grid.y, "");
+        std::string line;
+        for (u32 row = 0; row < tileset.grid.y && readLine(line); row++) {
+            if (line.rfind("// end", 0) == 0)
+                break;
+
+            std::vector<std::string> glyphs = splitGlyphs(line);
+            for (u32 column = 0; column < std::min((u32)glyphs.size(), tileset.grid.x); column++)
+                tileset.glyphs[row * tileset.grid.x + column] = glyphs[column];
+        }
+        return true;
+    }
+
+   public:
+    TilesetRegistry(AssetManager& _assets, std::string _directory)
+        : assets{_assets}, directory{std::move(_directory)} {}
+
+    TilesetRegistry(const TilesetRegistry&)            = delete;
+    TilesetRegistry& operator=(const TilesetRegistry&) = delete;
+
+    // Frees the textures. Registries tend to be static, and would otherwise outlive the window,
+    // so this is called before CloseWindow() rather than from the destructor.
+    void Unload() {
+        for (auto& [name, tileset] : tilesets)
+            if (tileset->texture.id) {
+                UnloadTexture(tileset->texture);
+                tileset->texture = Texture{};
+            }
+    }
+
+    // Starts loading <directory>/<name>.char and its image, and returns the tileset straight away,
+    // as a placeholder until it's ready. If loading fails it stays a ready placeholder, so callers
+    // can go on drawing.
+    const Tileset& Get(const std::string& name) {
+        auto it = tilesets.find(name);
+        if (it != tilesets.end())
+            return *it->second;
+
+        Tileset* tileset = (tilesets[name] = std::make_unique<Tileset>()).get();
+        tileset->BuildTables();
+
+        std::function<Decoded()> decode = [directory = directory, name] {
+            Decoded     decoded;
+            std::string image;
+            if (!parseChar(fs::path(directory) / (name + ".char"), decoded.tileset, image))
+                return decoded;
+
+            // Some sidecars name the image as it was before it got renamed to match the .char.
+            decoded.imagePath = fs::path(directory) / image;
+            if (!fs::exists(decoded.imagePath))
+                decoded.imagePath = fs::path(directory) / (name + ".png");
+
+            decoded.image = LoadImage(decoded.imagePath.string().c_str());
+            return decoded;
+        };
+
+        std::function<bool(Decoded&)> upload = [tileset, name](Decoded& decoded) {
+            if (decoded.image.data) {
+                decoded.tileset.texture  = LoadTextureFromImage(decoded.image);
+                decoded.tileset.tileSize = (f32)decoded.image.width / decoded.tileset.grid.x;
+                UnloadImage(decoded.image);
+                *tileset = std::move(decoded.tileset);
+            } else if (!decoded.imagePath.empty()) {
+                std::cout << "ERROR: ENGINE: Error loading tileset image: " << decoded.imagePath
+                          << "\n";
+            }
+
+            tileset->BuildTables();
+            tileset->ready = true;
+            std::cout << "INFO: ENGINE: Loaded tileset " << name << " (" << tileset->grid.x
+                      << "x" << tileset->grid.y << " tiles of " << tileset->tileSize << "px)\n";
+            return tileset->texture.id != 0;
+        };
+
+        assets.Load(decode, upload);
+        return *tileset;
+    }
+};